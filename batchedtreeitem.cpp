@@ -0,0 +1,164 @@
+#include "batchedtreeitem.h"
+#include <QFontMetricsF>
+#include <QPainter>
+#include <QStyleOptionGraphicsItem>
+#include <algorithm>
+
+BatchedTreeItem::BatchedTreeItem(int nodeRadius, QColor nodeColor)
+    : radius(nodeRadius)
+    , defaultColor(nodeColor.rgb())
+{
+    // Paint needs the exposed rect to cull against
+    setFlag(ItemUsesExtendedStyleOption);
+}
+
+void BatchedTreeItem::setNodes(const std::vector<LayoutNode>& layout, std::vector<QPointF> newPositions) {
+    prepareGeometryChange();
+    positions = std::move(newPositions);
+    keys.resize(layout.size());
+    parents.resize(layout.size());
+    subtrees.resize(layout.size());
+    colors.assign(layout.size(), defaultColor);
+    for (size_t i = 0; i < layout.size(); ++i) {
+        keys[i] = layout[i].key;
+        parents[i] = layout[i].parent;
+        float x = static_cast<float>(positions[i].x());
+        subtrees[i] = {x, x, static_cast<float>(positions[i].y()), 1, keys[i], keys[i]};
+    }
+    byKey = TreeLayout::keyOrder(layout);
+    
+    // Descendants follow their ancestors, so walking backwards folds every
+    // subtree into its parent once it is complete
+    for (size_t i = layout.size(); i-- > 1;) {
+        const Subtree& child = subtrees[i];
+        Subtree& parent = subtrees[parents[i]];
+        parent.left = std::min(parent.left, child.left);
+        parent.right = std::max(parent.right, child.right);
+        parent.bottom = std::max(parent.bottom, child.bottom);
+        parent.size += child.size;
+        parent.minKey = std::min(parent.minKey, child.minKey);
+        parent.maxKey = std::max(parent.maxKey, child.maxKey);
+    }
+    
+    // Labels of long keys reach past the circle
+    bounds = subtrees.empty() ? QRectF() : subtreeRect(0).adjusted(-40, 0, 40, 0);
+    update();
+}
+
+bool BatchedTreeItem::setColor(int key, QColor color) {
+    auto it = std::lower_bound(byKey.begin(), byKey.end(), key,
+                               [this](int index, int value) { return keys[index] < value; });
+    if (it == byKey.end() || keys[*it] != key) {
+        return false;
+    }
+    colors[*it] = color.rgb();
+    return true;
+}
+
+QRectF BatchedTreeItem::boundingRect() const {
+    return bounds;
+}
+
+QRectF BatchedTreeItem::subtreeRect(int node) const {
+    const Subtree& box = subtrees[node];
+    double top = positions[node].y();
+    return QRectF(box.left - radius, top - radius, box.right - box.left + 2 * radius, box.bottom - top + 2 * radius);
+}
+
+const QStaticText& BatchedTreeItem::label(int key) const {
+    if (QStaticText* cached = labels.object(key)) {
+        return *cached;
+    }
+    auto* text = new QStaticText(QString::number(key));
+    text->setTextFormat(Qt::PlainText);
+    labels.insert(key, text);
+    return *text;
+}
+
+void BatchedTreeItem::paint(QPainter* painter, const QStyleOptionGraphicsItem* option, QWidget*) {
+    if (positions.empty()) {
+        return;
+    }
+    double scale = QStyleOptionGraphicsItem::levelOfDetailFromTransform(painter->worldTransform());
+    const QRectF& exposed = option->exposedRect;
+    
+    // Sort what meets the exposed rect into single nodes and collapsed
+    // subtrees; edges are kept when their own box meets it. The walk is
+    // breadth-first, so once the node budget is spent it is the deepest
+    // levels that collapse, however skewed the tree.
+    std::vector<int> visible;
+    std::vector<int> collapsed;
+    std::vector<QLineF> edges;
+    std::vector<int> queue{0};
+    for (size_t head = 0; head < queue.size(); ++head) {
+        int node = queue[head];
+        QRectF box = subtreeRect(node);
+        if (!box.intersects(exposed)) continue;
+        
+        const Subtree& subtree = subtrees[node];
+        if (subtree.size > 1 && (visible.size() >= MAX_VISIBLE_NODES ||
+                                 std::max(box.width(), box.height()) * scale < COLLAPSE_PIXELS)) {
+            collapsed.push_back(node);
+            continue;
+        }
+        visible.push_back(node);
+        
+        const QPointF& pos = positions[node];
+        for (int child = node + 1; child < node + subtree.size; child += subtrees[child].size) {
+            const QPointF& childPos = positions[child];
+            if (std::max(pos.x(), childPos.x()) >= exposed.left() && std::min(pos.x(), childPos.x()) <= exposed.right() &&
+                pos.y() <= exposed.bottom() && childPos.y() >= exposed.top()) {
+                edges.emplace_back(pos, childPos);
+            }
+            queue.push_back(child);
+        }
+    }
+    
+    // Edges go first so the circles cover their ends
+    painter->setPen(QPen(Qt::black));
+    painter->drawLines(edges.data(), static_cast<int>(edges.size()));
+    
+    painter->setBrush(QColor::fromRgb(defaultColor).lighter(125));
+    for (int node : collapsed) {
+        painter->drawRoundedRect(subtreeRect(node), radius, radius);
+    }
+    
+    QRgb current = 0;
+    for (size_t n = 0; n < visible.size(); ++n) {
+        int i = visible[n];
+        if (n == 0 || colors[i] != current) {
+            current = colors[i];
+            painter->setBrush(QColor::fromRgb(current));
+        }
+        painter->drawEllipse(positions[i], radius, radius);
+    }
+    
+    if (scale >= LABEL_MIN_SCALE) {
+        for (int i : visible) {
+            const QStaticText& text = label(keys[i]);
+            QSizeF size = text.size();
+            painter->drawStaticText(positions[i] - QPointF(size.width() / 2, size.height() / 2), text);
+        }
+    }
+    
+    // Collapsed boxes are labelled in device pixels with as much of their
+    // count and key range as their visible part holds
+    painter->save();
+    QTransform toDevice = painter->worldTransform();
+    painter->resetTransform();
+    QRectF viewport = painter->viewport();
+    QFontMetricsF metrics = painter->fontMetrics();
+    for (int node : collapsed) {
+        QRectF onScreen = toDevice.mapRect(subtreeRect(node)) & viewport;
+        const Subtree& subtree = subtrees[node];
+        QString summary = QString("%1 keys\n%2 .. %3").arg(subtree.size).arg(subtree.minKey).arg(subtree.maxKey);
+        QSizeF needed = metrics.boundingRect(onScreen, Qt::AlignCenter, summary).size();
+        if (needed.width() > onScreen.width() || needed.height() > onScreen.height()) {
+            summary = QString::number(subtree.size);
+            needed = metrics.boundingRect(onScreen, Qt::AlignCenter, summary).size();
+            if (needed.width() > onScreen.width() || needed.height() > onScreen.height()) continue;
+        }
+        painter->drawText(onScreen, Qt::AlignCenter, summary);
+    }
+    painter->restore();
+}
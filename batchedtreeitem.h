@@ -0,0 +1,71 @@
+#ifndef BATCHEDTREEITEM_H
+#define BATCHEDTREEITEM_H
+
+#include <QGraphicsItem>
+#include <QCache>
+#include <QColor>
+#include <QStaticText>
+#include <vector>
+#include "treelayout.h"
+
+// One scene item that paints a whole tree from packed arrays: node
+// positions in layout order, each node's parent index and colour. It keeps
+// no per-node objects and the scene indexes a single item, so trees far
+// too large for one QGraphicsItem per node stay cheap to hold and to
+// update.
+//
+// Painting is level-of-detail: it walks down from the root level by level
+// using each subtree's bounding box as a spatial index, so it only visits
+// what meets the exposed rect. Subtrees under COLLAPSE_PIXELS on screen,
+// and every subtree reached once MAX_VISIBLE_NODES nodes are drawn, become
+// one box labelled with its key count, plus its key range where that fits.
+// Node labels come from a bounded cache of QStaticText and are left out
+// below LABEL_MIN_SCALE.
+class BatchedTreeItem : public QGraphicsItem {
+public:
+    BatchedTreeItem(int nodeRadius, QColor nodeColor);
+
+    // Replaces the drawing; `positions` are scene coordinates in layout order
+    void setNodes(const std::vector<LayoutNode>& layout, std::vector<QPointF> positions);
+
+    // Recolours the node holding `key` and returns false if there is none.
+    // Call update() once after a batch of changes.
+    bool setColor(int key, QColor color);
+
+    QRectF boundingRect() const override;
+    void paint(QPainter* painter, const QStyleOptionGraphicsItem* option, QWidget* widget) override;
+
+private:
+    static constexpr int LABEL_CACHE_SIZE = 4096;
+    static constexpr double COLLAPSE_PIXELS = 24;      // Subtrees smaller on screen become one box
+    static constexpr size_t MAX_VISIBLE_NODES = 10000; // Nodes drawn singly per paint
+    static constexpr double LABEL_MIN_SCALE = 0.5;
+
+    // A node's subtree: the box around its node centres, its size (its
+    // nodes follow it in layout order) and its key range
+    struct Subtree {
+        float left;
+        float right;
+        float bottom;
+        int size;
+        int minKey;
+        int maxKey;
+    };
+
+    int radius;
+    QRgb defaultColor;
+    std::vector<QPointF> positions;
+    std::vector<int> keys;
+    std::vector<int> parents;
+    std::vector<Subtree> subtrees;
+    std::vector<QRgb> colors;
+    std::vector<int> byKey;   // Node indices in increasing key order
+    QRectF bounds;
+
+    mutable QCache<int, QStaticText> labels{LABEL_CACHE_SIZE};
+
+    const QStaticText& label(int key) const;
+    QRectF subtreeRect(int node) const;   // Its box with room for the circles
+};
+
+#endif // BATCHEDTREEITEM_H
@@ -1,47 +1,419 @@
 #ifndef BINARYSEARCHTREE_H
 #define BINARYSEARCHTREE_H
 
+#include <atomic>
+#include <cstdint>
 #include <memory>
 #include <vector>
 #include <functional>
+#include <iterator>
+#include <type_traits>
+#include "nodepool.h"
+#include "threadpool.h"
 
-struct BSTNode {
-    int value;
-    std::shared_ptr<BSTNode> left;
-    std::shared_ptr<BSTNode> right;
+// Node of a BasicBinarySearchTree. The child links come first so a small key
+// packs into the same 8-byte slot as height/size: with int keys a node is
+// 32 bytes, two per cache line.
+template <typename Key>
+struct BasicBSTNode {
+    BasicBSTNode* left;
+    BasicBSTNode* right;
+    Key value;
+    int height;   // Height of the subtree rooted here, a leaf has height 1
+    int size;     // Number of nodes in the subtree rooted here
+    bool red;     // Colour bit, only meaningful in red-black mode
     
-    explicit BSTNode(int val) : value(val), left(nullptr), right(nullptr) {}
+    BasicBSTNode() = default;
+    explicit BasicBSTNode(const Key& val) : left(nullptr), right(nullptr), value(val), height(1), size(1), red(true) {}
 };
 
-class BinarySearchTree {
+using BSTNode = BasicBSTNode<int>;
+
+// How the tree restructures itself after insert and remove.
+enum class BalancePolicy {
+    None,       // Plain BST, shape depends on insertion order
+    AVL,        // Subtree heights differ by at most one
+    RedBlack    // Classic red-black colouring, height <= 2 log2(n + 1)
+};
+
+// Summary kept up to date by every mutation, so reading it is O(1).
+template <typename Key>
+struct BasicTreeStats {
+    size_t size = 0;
+    int height = 0;
+    Key min{};    // Smallest key, meaningless when size == 0
+    Key max{};    // Largest key, meaningless when size == 0
+};
+
+using TreeStats = BasicTreeStats<int>;
+
+// Result of a full structural check of the tree.
+struct ValidationReport {
+    bool ordered = true;      // BST ordering holds for every node
+    bool consistent = true;   // Stored subtree sizes and heights are correct
+    bool balanced = true;     // The balance policy's invariants hold
+    size_t size = 0;
+    int height = 0;
+};
+
+// Ordered set of keys in a binary search tree, optionally self-balancing.
+//
+// Key must be copyable and trivially destructible (integers, or fixed-length
+// strings such as std::array<char, 16>); Compare is a strict weak ordering
+// and Allocator supplies the node memory. Integral keys under std::less get
+// compile-time fast paths: plain == and < instead of two Compare calls, and
+// branchless child selection in the read-only descents.
+//
+// The definitions live in binarysearchtree_impl.h. The int and 64-bit
+// instantiations are compiled once in binarysearchtree.cpp; other key types
+// include the _impl header.
+template <typename Key, typename Compare = std::less<Key>, typename Allocator = std::allocator<Key>>
+class BasicBinarySearchTree {
 public:
-    BinarySearchTree() : root(nullptr) {}
+    using key_type = Key;
+    using value_type = Key;
+    using key_compare = Compare;
+    using allocator_type = Allocator;
+    using Node = BasicBSTNode<Key>;
+    using Stats = BasicTreeStats<Key>;
+    
+    // Lazy inorder iterator. It keeps the pending ancestors on a stack, so it
+    // holds O(height) state and every step is amortised O(1). Any insert or
+    // remove invalidates all iterators.
+    class const_iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = Key;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const Key*;
+        using reference = const Key&;
+        
+        const_iterator() = default;
+        
+        reference operator*() const { return stack.back()->value; }
+        pointer operator->() const { return &stack.back()->value; }
+        
+        const_iterator& operator++() {
+            const Node* node = stack.back()->right;
+            stack.pop_back();
+            descendLeft(node);
+            return *this;
+        }
+        
+        const_iterator operator++(int) {
+            const_iterator previous = *this;
+            ++*this;
+            return previous;
+        }
+        
+        bool operator==(const const_iterator& other) const { return current() == other.current(); }
+        bool operator!=(const const_iterator& other) const { return current() != other.current(); }
+        
+    private:
+        friend class BasicBinarySearchTree;
+        std::vector<const Node*> stack;
+        
+        const Node* current() const { return stack.empty() ? nullptr : stack.back(); }
+        
+        void descendLeft(const Node* node) {
+            for (; node; node = node->left) {
+                stack.push_back(node);
+            }
+        }
+    };
+    using iterator = const_iterator;
+    
+    // Half-open view [first, last) over the keys of a range query.
+    class Range {
+    public:
+        Range(const_iterator from, const_iterator to) : first(std::move(from)), last(std::move(to)) {}
+        const_iterator begin() const { return first; }
+        const_iterator end() const { return last; }
+        bool empty() const { return first == last; }
+        
+    private:
+        const_iterator first;
+        const_iterator last;
+    };
+    
+    explicit BasicBinarySearchTree(BalancePolicy policy = BalancePolicy::None,
+                                   const Compare& compare = Compare(),
+                                   const Allocator& allocator = Allocator())
+        : root(nullptr), policy(policy), compare(compare), pool(allocator) {}
+    BasicBinarySearchTree(const BasicBinarySearchTree&) = delete;
+    BasicBinarySearchTree& operator=(const BasicBinarySearchTree&) = delete;
+    BasicBinarySearchTree(BasicBinarySearchTree&& other) noexcept;
+    BasicBinarySearchTree& operator=(BasicBinarySearchTree&& other) noexcept;
+    
+    bool insert(const Key& value);
+    bool remove(const Key& value);
     
-    bool insert(int value);
-    bool remove(int value);
-    std::vector<int> search(int value) const;
+    // Bulk mutations. The result has one flag per input element telling whether
+    // that element changed the tree (repeated values only count once). Balanced
+    // trees merge a large batch with one linear rebuild instead of walking from
+    // the root once per key.
+    std::vector<bool> insertBatch(const std::vector<Key>& values);
+    std::vector<bool> removeBatch(const std::vector<Key>& values);
+    
+    // Lookups. contains() only walks down from the root and never allocates.
+    // The path-reporting forms return whether `value` was found and report
+    // the keys from the root to where the search stopped: search(value, path)
+    // into a buffer it clears first, so reusing one avoids reallocating, and
+    // visitPath by calling visit(key) for each.
+    bool contains(const Key& value) const;
+    bool search(const Key& value, std::vector<Key>& path) const;
+    template <typename Visit>
+    bool visitPath(const Key& value, Visit visit) const;
+    std::vector<Key> search(const Key& value) const;
     void clear();
     
-    std::vector<int> inorderTraversal() const;
-    std::vector<int> preorderTraversal() const;
-    std::vector<int> postorderTraversal() const;
+    std::vector<Key> inorderTraversal() const;
+    std::vector<Key> preorderTraversal() const;
+    std::vector<Key> postorderTraversal() const;
+    
+    const_iterator begin() const;
+    const_iterator end() const { return const_iterator(); }
+    const_iterator lower_bound(const Key& value) const;   // First key >= value
+    const_iterator upper_bound(const Key& value) const;   // First key > value
+    Range range(const Key& low, const Key& high) const;   // Keys in [low, high], O(log n + k)
+    
+    BalancePolicy getBalancePolicy() const { return policy; }
+    void setBalancePolicy(BalancePolicy newPolicy);
     
-    std::shared_ptr<BSTNode> getRoot() const { return root; }
+    const Node* getRoot() const { return root; }
     bool isEmpty() const { return root == nullptr; }
+    size_t size() const { return static_cast<size_t>(sizeOf(root)); }
+    Stats stats() const;
+    
+    // Checks ordering, augmentation and balance. Subtrees above the parallel
+    // cutoff are checked concurrently on the shared pool. Only reads the
+    // tree, so it may run on a worker thread while nothing mutates it.
+    ValidationReport validate() const;
+    
+    // Folds map(key) over all keys in sorted order with `reduce`, which must
+    // be associative with `identity` as its neutral element. Large subtrees
+    // are reduced in parallel, so both functions may run concurrently.
+    template <typename Result, typename Map, typename Reduce>
+    Result mapReduce(Result identity, Map map, Reduce reduce) const;
+    
+    // Order statistics, O(log n) on balanced trees thanks to subtree sizes
+    size_t rank(const Key& value) const;                    // Number of keys < value
+    const Key& select(size_t index) const;                  // Key at 0-based sorted position, throws std::out_of_range
+    size_t countRange(const Key& low, const Key& high) const;   // Number of keys in [low, high]
     
-    std::vector<int> serialize() const;
-    void deserialize(const std::vector<int>& nodes);
+    std::vector<Key> serialize() const;
+    void deserialize(const std::vector<Key>& nodes);
+    void deserialize(const Key* nodes, size_t count);
+    
+    // Linear-time bulk construction, replacing the current contents.
+    // buildFromSorted needs strictly increasing values and yields a perfectly
+    // balanced tree; buildFromPreorder rebuilds the exact shape serialize()
+    // produced and returns false (leaving the tree empty) on an invalid stream.
+    void buildFromSorted(const Key* values, size_t count);
+    bool buildFromPreorder(const Key* values, size_t count);
+    
+    // Join-based primitives. They relink existing nodes instead of copying
+    // keys and need a balanced policy (std::logic_error otherwise).
+    //
+    // split() moves the keys greater than `key` into the returned tree, keeps
+    // the smaller ones here and drops `key` itself, reporting whether it was
+    // present. The two trees share node memory until both are cleared.
+    // join() builds left + key + right; every key of `left` must order before
+    // `key` and every key of `right` after it (std::invalid_argument
+    // otherwise). It takes over both trees, converting `right` to the policy
+    // of `left` if they differ.
+    BasicBinarySearchTree split(const Key& key, bool* found = nullptr);
+    static BasicBinarySearchTree join(BasicBinarySearchTree&& left, const Key& key, BasicBinarySearchTree&& right);
+    
+    // Set operations leaving the result here and consuming `other`, in
+    // O(m log(n/m + 1)) work for trees of sizes m <= n. They divide and
+    // conquer over split/join and run large independent subproblems on
+    // worker threads.
+    void unionWith(BasicBinarySearchTree&& other);
+    void intersectWith(BasicBinarySearchTree&& other);
+    void differenceWith(BasicBinarySearchTree&& other);
 
 private:
-    std::shared_ptr<BSTNode> root;
-    
-    bool searchRecursive(const std::shared_ptr<BSTNode>& node, int value, std::vector<int>& path) const;
-    std::shared_ptr<BSTNode> removeRecursive(std::shared_ptr<BSTNode> node, int value, bool& success);
-    std::shared_ptr<BSTNode> findMin(const std::shared_ptr<BSTNode> node) const;
-    void clearRecursive(std::shared_ptr<BSTNode>& node);
-    void traverseInorder(const std::shared_ptr<BSTNode>& node, std::vector<int>& result) const;
-    void traversePreorder(const std::shared_ptr<BSTNode>& node, std::vector<int>& result) const;
-    void traversePostorder(const std::shared_ptr<BSTNode>& node, std::vector<int>& result) const;
+    // Integral keys ordered by std::less compare with the built-in operators
+    static constexpr bool INTEGRAL_KEYS =
+        std::is_integral<Key>::value &&
+        (std::is_same<Compare, std::less<Key>>::value || std::is_same<Compare, std::less<>>::value);
+    
+    static_assert(std::is_trivially_destructible<Key>::value,
+                  "pooled nodes are never destroyed individually, so Key must be trivially destructible");
+    
+    Node* root;
+    BalancePolicy policy;
+    Compare compare;
+    Key minValue{};
+    Key maxValue{};
+    NodePool<Node, Allocator> pool;
+    std::vector<Node**> path;  // Scratch stack of links from the root, reused across updates
+    
+    bool less(const Key& a, const Key& b) const {
+        if constexpr (INTEGRAL_KEYS) {
+            return a < b;
+        } else {
+            return compare(a, b);
+        }
+    }
+    
+    bool equal(const Key& a, const Key& b) const {
+        if constexpr (INTEGRAL_KEYS) {
+            return a == b;
+        } else {
+            return !compare(a, b) && !compare(b, a);
+        }
+    }
+    
+    // Child on the side of `value`, which must differ from node->value
+    const Node* childToward(const Node* node, const Key& value) const {
+        if constexpr (INTEGRAL_KEYS) {
+            const Node* children[2] = {node->left, node->right};
+            return children[node->value < value];
+        } else {
+            return compare(value, node->value) ? node->left : node->right;
+        }
+    }
+    
+    void rebalancePath();
+    void refreshBounds();
+    std::vector<size_t> uniqueSortedIndices(const std::vector<Key>& values) const;
+    bool isStrictlyIncreasing(const Key* values, size_t count) const;
+    bool preferRebuild(size_t batchSize) const;
+    Node* buildBalanced(const Key* values, size_t count, int depth, int redDepth);
+    
+    size_t countBelow(const Key& value, bool inclusive) const;
+    
+    // Nodes a set operation discards, chained through `left` with a lock-free
+    // push so workers never touch the pool. They are freed once all finish.
+    class DropList {
+    public:
+        void push(Node* subtree);
+        Node* take() { return head.exchange(nullptr); }
+        
+    private:
+        std::atomic<Node*> head{nullptr};
+    };
+    
+    // Subproblems smaller than this (in nodes) are not worth a thread
+    static constexpr int PARALLEL_CUTOFF = 8192;
+    
+    void requireBalanced(const char* operation) const;
+    void prepareSetOperation(BasicBinarySearchTree& other, const char* operation);
+    void finishSetOperation(Node* result, DropList& dropped);
+    static int forkLevels();
+    
+    // A detached subtree with, in red-black mode, its black height: the
+    // black nodes on any path from its root down to a null link. Handing it
+    // down through split, join and the set operations spares every
+    // red-black join a recount along a spine.
+    struct Part {
+        Node* node;
+        int black;
+    };
+    
+    Part whole(Node* node) const { return {node, policy == BalancePolicy::RedBlack ? blackHeight(node) : 0}; }
+    static Part childOf(const Part& parent, Node* child) { return {child, parent.black - (parent.node->red ? 0 : 1)}; }
+    
+    Part joinNodes(Part left, Node* middle, Part right) const;
+    Part joinPair(Part left, Part right) const;
+    Node* splitNodes(Part node, const Key& key, Part& lower, Part& upper) const;
+    Part unionNodes(Part a, Part b, int forks, DropList& dropped) const;
+    Part intersectNodes(Part a, Part b, int forks, DropList& dropped) const;
+    Part differenceNodes(Part a, Part b, int forks, DropList& dropped) const;
+    static Node* joinAVL(Node* left, Node* middle, Node* right);
+    static Part joinRB(Part left, Node* middle, Part right);
+    static int blackHeight(const Node* node);
+    
+    static int heightOf(const Node* node) { return node ? node->height : 0; }
+    static int sizeOf(const Node* node) { return node ? node->size : 0; }
+    static bool isRed(const Node* node) { return node && node->red; }
+    static void update(Node* node);
+    static void rotateLeft(Node*& link);
+    static void rotateRight(Node*& link);
+    static void rebalanceAVL(Node*& link);
+    static void updateLinks(const std::vector<Node**>& links);
+    static void updateSubtree(Node* node);
+    static bool insertFixupRB(std::vector<Node**>& links);
+    static void removeFixupRB(std::vector<Node**>& links);
+    
+    // Whole-tree passes split into subtrees: large ones fork onto the shared
+    // work-stealing pool, small ones run sequentially
+    enum class TraversalOrder { Inorder, Preorder, Postorder };
+    
+    // What validating a subtree tells its parent, plus the verdicts so far
+    struct SubtreeCheck {
+        int height = 0;
+        int size = 0;
+        int blackHeight = 1;   // Null links count as black
+        bool ordered = true;
+        bool consistent = true;
+        bool balanced = true;
+    };
+    
+    void fillTraversal(const Node* node, Key* out, TraversalOrder order, int forks) const;
+    void traverseInorder(const Node* node, Key* out) const;
+    void traversePreorder(const Node* node, Key* out) const;
+    void traversePostorder(const Node* node, Key* out) const;
+    SubtreeCheck checkSubtree(const Node* node, const Key* low, const Key* high, int forks) const;
+    SubtreeCheck checkNode(const Node* node, const Key* low, const Key* high,
+                           const SubtreeCheck& left, const SubtreeCheck& right) const;
+    
+    template <typename Result, typename Map, typename Reduce>
+    Result reduceSubtree(const Node* node, const Result& identity, Map& map, Reduce& reduce, int forks) const;
 };
 
+template <typename Key, typename Compare, typename Allocator>
+template <typename Visit>
+bool BasicBinarySearchTree<Key, Compare, Allocator>::visitPath(const Key& value, Visit visit) const {
+    for (const Node* node = root; node; node = childToward(node, value)) {
+        visit(node->value);
+        if (equal(value, node->value)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+template <typename Key, typename Compare, typename Allocator>
+template <typename Result, typename Map, typename Reduce>
+Result BasicBinarySearchTree<Key, Compare, Allocator>::mapReduce(Result identity, Map map, Reduce reduce) const {
+    return reduceSubtree(root, identity, map, reduce, forkLevels());
+}
+
+template <typename Key, typename Compare, typename Allocator>
+template <typename Result, typename Map, typename Reduce>
+Result BasicBinarySearchTree<Key, Compare, Allocator>::reduceSubtree(
+    const Node* node, const Result& identity, Map& map, Reduce& reduce, int forks) const {
+    if (forks <= 0 || sizeOf(node) < PARALLEL_CUTOFF) {
+        Result total = identity;
+        std::vector<const Node*> stack;
+        while (node || !stack.empty()) {
+            while (node) {
+                stack.push_back(node);
+                node = node->left;
+            }
+            node = stack.back();
+            stack.pop_back();
+            total = reduce(total, map(node->value));
+            node = node->right;
+        }
+        return total;
+    }
+    
+    Result left = identity;
+    Result right = identity;
+    parallelInvoke(true,
+        [&] { left = reduceSubtree(node->left, identity, map, reduce, forks - 1); },
+        [&] { right = reduceSubtree(node->right, identity, map, reduce, forks - 1); });
+    return reduce(reduce(left, map(node->value)), right);
+}
+
+// The tree the GUI and the other containers use
+using BinarySearchTree = BasicBinarySearchTree<int>;
+
+extern template class BasicBinarySearchTree<int>;
+extern template class BasicBinarySearchTree<std::int64_t>;
+
 #endif // BINARYSEARCHTREE_H
@@ -0,0 +1,1383 @@
+#ifndef BINARYSEARCHTREE_IMPL_H
+#define BINARYSEARCHTREE_IMPL_H
+
+// Member definitions of BasicBinarySearchTree. Include this instead of
+// binarysearchtree.h to instantiate the tree for a key type other than the
+// ones compiled into binarysearchtree.cpp.
+
+#include "binarysearchtree.h"
+#include <algorithm>
+#include <cstdlib>
+#include <stdexcept>
+#include <string>
+
+template <typename Key, typename Compare, typename Allocator>
+BasicBinarySearchTree<Key, Compare, Allocator>::BasicBinarySearchTree(BasicBinarySearchTree&& other) noexcept
+    : root(other.root)
+    , policy(other.policy)
+    , compare(std::move(other.compare))
+    , minValue(other.minValue)
+    , maxValue(other.maxValue)
+    , pool(std::move(other.pool))
+{
+    other.root = nullptr;
+}
+
+template <typename Key, typename Compare, typename Allocator>
+BasicBinarySearchTree<Key, Compare, Allocator>& BasicBinarySearchTree<Key, Compare, Allocator>::operator=(BasicBinarySearchTree&& other) noexcept {
+    if (this != &other) {
+        root = other.root;
+        policy = other.policy;
+        compare = std::move(other.compare);
+        minValue = other.minValue;
+        maxValue = other.maxValue;
+        pool = std::move(other.pool);
+        other.root = nullptr;
+    }
+    return *this;
+}
+
+template <typename Key, typename Compare, typename Allocator>
+bool BasicBinarySearchTree<Key, Compare, Allocator>::insert(const Key& value) {
+    bool wasEmpty = root == nullptr;
+    path.clear();
+    Node** link = &root;
+    
+    while (*link) {
+        Node* current = *link;
+        if (equal(value, current->value)) {
+            return false;  // Value already exists
+        }
+        
+        path.push_back(link);
+        link = less(value, current->value) ? &current->left : &current->right;
+    }
+    
+    *link = pool.allocate(value);
+    path.push_back(link);
+    rebalancePath();
+    
+    if (wasEmpty || less(value, minValue)) {
+        minValue = value;
+    }
+    if (wasEmpty || less(maxValue, value)) {
+        maxValue = value;
+    }
+    return true;
+}
+
+template <typename Key, typename Compare, typename Allocator>
+bool BasicBinarySearchTree<Key, Compare, Allocator>::remove(const Key& value) {
+    path.clear();
+    Node** link = &root;
+    
+    while (*link && !equal((*link)->value, value)) {
+        path.push_back(link);
+        link = less(value, (*link)->value) ? &(*link)->left : &(*link)->right;
+    }
+    if (!*link) {
+        return false;
+    }
+    path.push_back(link);
+    
+    // A node with two children takes over its inorder successor's value,
+    // and the successor (which has no left child) is unlinked instead
+    Node* node = *link;
+    if (node->left && node->right) {
+        link = &node->right;
+        path.push_back(link);
+        while ((*link)->left) {
+            link = &(*link)->left;
+            path.push_back(link);
+        }
+        node->value = (*link)->value;
+    }
+    
+    Node* victim = *link;
+    bool removedBlack = !victim->red;
+    *link = victim->left ? victim->left : victim->right;
+    pool.deallocate(victim);
+    
+    if (policy != BalancePolicy::RedBlack) {
+        rebalancePath();
+    } else {
+        updateLinks(path);
+        if (removedBlack) {
+            if (isRed(*link)) {
+                (*link)->red = false;
+            } else {
+                removeFixupRB(path);
+                updateLinks(path);
+            }
+        }
+    }
+    
+    if (equal(value, minValue) || equal(value, maxValue)) {
+        refreshBounds();
+    }
+    return true;
+}
+
+template <typename Key, typename Compare, typename Allocator>
+std::vector<bool> BasicBinarySearchTree<Key, Compare, Allocator>::insertBatch(const std::vector<Key>& values) {
+    std::vector<bool> results(values.size(), false);
+    
+    // Plain trees take their shape from insertion order, so keep that order
+    if (policy == BalancePolicy::None) {
+        for (size_t i = 0; i < values.size(); ++i) {
+            results[i] = insert(values[i]);
+        }
+        return results;
+    }
+    
+    std::vector<size_t> order = uniqueSortedIndices(values);
+    if (!preferRebuild(order.size())) {
+        // Ascending keys share most of their search path, which stays in cache
+        for (size_t index : order) {
+            results[index] = insert(values[index]);
+        }
+        return results;
+    }
+    
+    std::vector<Key> merged;
+    merged.reserve(size() + order.size());
+    auto existing = begin();
+    for (size_t index : order) {
+        const Key& value = values[index];
+        while (existing != end() && less(*existing, value)) {
+            merged.push_back(*existing++);
+        }
+        if (existing != end() && equal(*existing, value)) {
+            continue;
+        }
+        merged.push_back(value);
+        results[index] = true;
+    }
+    merged.insert(merged.end(), existing, end());
+    buildFromSorted(merged.data(), merged.size());
+    return results;
+}
+
+template <typename Key, typename Compare, typename Allocator>
+std::vector<bool> BasicBinarySearchTree<Key, Compare, Allocator>::removeBatch(const std::vector<Key>& values) {
+    std::vector<bool> results(values.size(), false);
+    std::vector<size_t> order = uniqueSortedIndices(values);
+    
+    if (policy == BalancePolicy::None || !preferRebuild(order.size())) {
+        for (size_t index : order) {
+            results[index] = remove(values[index]);
+        }
+        return results;
+    }
+    
+    std::vector<Key> kept;
+    kept.reserve(size());
+    auto existing = begin();
+    for (size_t index : order) {
+        const Key& value = values[index];
+        while (existing != end() && less(*existing, value)) {
+            kept.push_back(*existing++);
+        }
+        if (existing != end() && equal(*existing, value)) {
+            ++existing;
+            results[index] = true;
+        }
+    }
+    kept.insert(kept.end(), existing, end());
+    buildFromSorted(kept.data(), kept.size());
+    return results;
+}
+
+// Positions of the first occurrence of every distinct value, in ascending
+// order of value.
+template <typename Key, typename Compare, typename Allocator>
+std::vector<size_t> BasicBinarySearchTree<Key, Compare, Allocator>::uniqueSortedIndices(const std::vector<Key>& values) const {
+    std::vector<size_t> order(values.size());
+    for (size_t i = 0; i < order.size(); ++i) {
+        order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(), [this, &values](size_t a, size_t b) {
+        return less(values[a], values[b]);
+    });
+    order.erase(std::unique(order.begin(), order.end(), [this, &values](size_t a, size_t b) {
+        return equal(values[a], values[b]);
+    }), order.end());
+    return order;
+}
+
+template <typename Key, typename Compare, typename Allocator>
+bool BasicBinarySearchTree<Key, Compare, Allocator>::isStrictlyIncreasing(const Key* values, size_t count) const {
+    return std::adjacent_find(values, values + count, [this](const Key& a, const Key& b) {
+        return !less(a, b);
+    }) == values + count;
+}
+
+// A rebuild touches every node once, single updates cost a root-to-leaf
+// walk each; pick whichever does less work.
+template <typename Key, typename Compare, typename Allocator>
+bool BasicBinarySearchTree<Key, Compare, Allocator>::preferRebuild(size_t batchSize) const {
+    size_t treeSize = size();
+    size_t depth = static_cast<size_t>(root ? root->height : 0);
+    return batchSize * (depth + 1) >= treeSize + batchSize;
+}
+
+// Re-reads the cached extremes from the leftmost and rightmost nodes.
+template <typename Key, typename Compare, typename Allocator>
+void BasicBinarySearchTree<Key, Compare, Allocator>::refreshBounds() {
+    if (!root) {
+        return;
+    }
+    const Node* node = root;
+    while (node->left) {
+        node = node->left;
+    }
+    minValue = node->value;
+    
+    node = root;
+    while (node->right) {
+        node = node->right;
+    }
+    maxValue = node->value;
+}
+
+template <typename Key, typename Compare, typename Allocator>
+typename BasicBinarySearchTree<Key, Compare, Allocator>::Stats BasicBinarySearchTree<Key, Compare, Allocator>::stats() const {
+    Stats result;
+    if (root) {
+        result.size = static_cast<size_t>(root->size);
+        result.height = root->height;
+        result.min = minValue;
+        result.max = maxValue;
+    }
+    return result;
+}
+
+template <typename Key, typename Compare, typename Allocator>
+ValidationReport BasicBinarySearchTree<Key, Compare, Allocator>::validate() const {
+    SubtreeCheck check = checkSubtree(root, nullptr, nullptr, forkLevels());
+    ValidationReport report;
+    report.ordered = check.ordered;
+    report.consistent = check.consistent;
+    report.balanced = check.balanced && !(policy == BalancePolicy::RedBlack && isRed(root));
+    report.size = static_cast<size_t>(check.size);
+    report.height = check.height;
+    return report;
+}
+
+// Checks the subtree at `node` against the key bounds inherited from its
+// ancestors (null means unbounded). Large subtrees check their two halves in
+// parallel; below the cutoff one iterative pass does the whole subtree.
+template <typename Key, typename Compare, typename Allocator>
+typename BasicBinarySearchTree<Key, Compare, Allocator>::SubtreeCheck BasicBinarySearchTree<Key, Compare, Allocator>::checkSubtree(
+    const Node* node, const Key* low, const Key* high, int forks) const {
+    if (forks > 0 && sizeOf(node) >= PARALLEL_CUTOFF) {
+        SubtreeCheck left;
+        SubtreeCheck right;
+        parallelInvoke(true,
+            [&] { left = checkSubtree(node->left, low, &node->value, forks - 1); },
+            [&] { right = checkSubtree(node->right, &node->value, high, forks - 1); });
+        return checkNode(node, low, high, left, right);
+    }
+    
+    // Postorder walk: bounds go down with the frames, child results come back
+    // up on the second stack
+    struct Frame {
+        const Node* node;
+        const Key* low;
+        const Key* high;
+        bool expanded;
+    };
+    std::vector<Frame> frames{{node, low, high, false}};
+    std::vector<SubtreeCheck> results;
+    
+    while (!frames.empty()) {
+        Frame frame = frames.back();
+        if (!frame.node) {
+            frames.pop_back();
+            results.push_back(SubtreeCheck());
+            continue;
+        }
+        if (!frame.expanded) {
+            frames.back().expanded = true;
+            frames.push_back({frame.node->right, &frame.node->value, frame.high, false});
+            frames.push_back({frame.node->left, frame.low, &frame.node->value, false});
+            continue;
+        }
+        frames.pop_back();
+        
+        SubtreeCheck right = results.back();
+        results.pop_back();
+        SubtreeCheck left = results.back();
+        results.pop_back();
+        results.push_back(checkNode(frame.node, frame.low, frame.high, left, right));
+    }
+    return results.back();
+}
+
+// Combines the checks of a node's two subtrees with the node's own bounds,
+// augmentation and balance rules.
+template <typename Key, typename Compare, typename Allocator>
+typename BasicBinarySearchTree<Key, Compare, Allocator>::SubtreeCheck BasicBinarySearchTree<Key, Compare, Allocator>::checkNode(
+    const Node* node, const Key* low, const Key* high, const SubtreeCheck& left, const SubtreeCheck& right) const {
+    SubtreeCheck result;
+    result.height = 1 + std::max(left.height, right.height);
+    result.size = 1 + left.size + right.size;
+    result.blackHeight = left.blackHeight + (node->red ? 0 : 1);
+    
+    result.ordered = left.ordered && right.ordered &&
+                     (!low || less(*low, node->value)) && (!high || less(node->value, *high));
+    result.consistent = left.consistent && right.consistent &&
+                        node->height == result.height && node->size == result.size;
+    result.balanced = left.balanced && right.balanced;
+    if (policy == BalancePolicy::AVL && std::abs(left.height - right.height) > 1) {
+        result.balanced = false;
+    }
+    if (policy == BalancePolicy::RedBlack &&
+        (left.blackHeight != right.blackHeight ||
+         (node->red && (isRed(node->left) || isRed(node->right))))) {
+        result.balanced = false;
+    }
+    return result;
+}
+
+// Restores heights, sizes and balance along `path` after its bottom link changed.
+template <typename Key, typename Compare, typename Allocator>
+void BasicBinarySearchTree<Key, Compare, Allocator>::rebalancePath() {
+    switch (policy) {
+    case BalancePolicy::None:
+        updateLinks(path);
+        break;
+    case BalancePolicy::AVL:
+        for (auto it = path.rbegin(); it != path.rend(); ++it) {
+            if (**it) {
+                rebalanceAVL(**it);
+            }
+        }
+        break;
+    case BalancePolicy::RedBlack:
+        updateLinks(path);
+        insertFixupRB(path);
+        updateLinks(path);
+        break;
+    }
+}
+
+template <typename Key, typename Compare, typename Allocator>
+void BasicBinarySearchTree<Key, Compare, Allocator>::setBalancePolicy(BalancePolicy newPolicy) {
+    if (newPolicy == policy) {
+        return;
+    }
+    
+    // Any balanced tree is a valid plain BST, the other direction needs a rebuild
+    policy = newPolicy;
+    if (policy == BalancePolicy::None || !root) {
+        return;
+    }
+    std::vector<Key> values = inorderTraversal();
+    buildFromSorted(values.data(), values.size());
+}
+
+template <typename Key, typename Compare, typename Allocator>
+void BasicBinarySearchTree<Key, Compare, Allocator>::update(Node* node) {
+    node->height = 1 + std::max(heightOf(node->left), heightOf(node->right));
+    node->size = 1 + sizeOf(node->left) + sizeOf(node->right);
+}
+
+template <typename Key, typename Compare, typename Allocator>
+void BasicBinarySearchTree<Key, Compare, Allocator>::rotateLeft(Node*& link) {
+    Node* node = link;
+    Node* pivot = node->right;
+    node->right = pivot->left;
+    pivot->left = node;
+    update(node);
+    update(pivot);
+    link = pivot;
+}
+
+template <typename Key, typename Compare, typename Allocator>
+void BasicBinarySearchTree<Key, Compare, Allocator>::rotateRight(Node*& link) {
+    Node* node = link;
+    Node* pivot = node->left;
+    node->left = pivot->right;
+    pivot->right = node;
+    update(node);
+    update(pivot);
+    link = pivot;
+}
+
+template <typename Key, typename Compare, typename Allocator>
+void BasicBinarySearchTree<Key, Compare, Allocator>::rebalanceAVL(Node*& link) {
+    Node* node = link;
+    update(node);
+    int balance = heightOf(node->left) - heightOf(node->right);
+    
+    if (balance > 1) {
+        if (heightOf(node->left->left) < heightOf(node->left->right)) {
+            rotateLeft(node->left);
+        }
+        rotateRight(link);
+    } else if (balance < -1) {
+        if (heightOf(node->right->right) < heightOf(node->right->left)) {
+            rotateRight(node->right);
+        }
+        rotateLeft(link);
+    }
+}
+
+// Recomputes heights and sizes for a whole subtree in postorder, without recursion.
+template <typename Key, typename Compare, typename Allocator>
+void BasicBinarySearchTree<Key, Compare, Allocator>::updateSubtree(Node* node) {
+    std::vector<Node*> stack;
+    Node* lastVisited = nullptr;
+    
+    while (node || !stack.empty()) {
+        if (node) {
+            stack.push_back(node);
+            node = node->left;
+            continue;
+        }
+        Node* top = stack.back();
+        if (top->right && top->right != lastVisited) {
+            node = top->right;
+        } else {
+            update(top);
+            lastVisited = top;
+            stack.pop_back();
+        }
+    }
+}
+
+// Recomputes heights and sizes bottom-up along a root-to-node chain of links.
+template <typename Key, typename Compare, typename Allocator>
+void BasicBinarySearchTree<Key, Compare, Allocator>::updateLinks(const std::vector<Node**>& links) {
+    for (auto it = links.rbegin(); it != links.rend(); ++it) {
+        if (**it) {
+            update(**it);
+        }
+    }
+}
+
+// Fixes a red-red violation at the bottom of `links` (CLRS insert fixup),
+// using the link stack in place of parent pointers.
+template <typename Key, typename Compare, typename Allocator>
+bool BasicBinarySearchTree<Key, Compare, Allocator>::insertFixupRB(std::vector<Node**>& links) {
+    size_t k = links.size() - 1;
+    
+    while (k >= 2 && isRed(*links[k - 1])) {
+        Node* node = *links[k];
+        Node* parent = *links[k - 1];
+        Node* grand = *links[k - 2];
+        
+        if (parent == grand->left) {
+            Node* uncle = grand->right;
+            if (isRed(uncle)) {
+                parent->red = false;
+                uncle->red = false;
+                grand->red = true;
+                k -= 2;
+                continue;
+            }
+            if (node == parent->right) {
+                rotateLeft(grand->left);
+            }
+            rotateRight(*links[k - 2]);
+        } else {
+            Node* uncle = grand->left;
+            if (isRed(uncle)) {
+                parent->red = false;
+                uncle->red = false;
+                grand->red = true;
+                k -= 2;
+                continue;
+            }
+            if (node == parent->left) {
+                rotateRight(grand->right);
+            }
+            rotateLeft(*links[k - 2]);
+        }
+        
+        (*links[k - 2])->red = false;
+        grand->red = true;
+        break;
+    }
+    
+    // Recolouring the top red node black adds a black level to every path
+    bool grew = isRed(*links.front());
+    (*links.front())->red = false;
+    return grew;
+}
+
+// Resolves the extra black left at the bottom of `links` after unlinking a
+// black node (CLRS delete fixup). The bottom link may be null.
+template <typename Key, typename Compare, typename Allocator>
+void BasicBinarySearchTree<Key, Compare, Allocator>::removeFixupRB(std::vector<Node**>& links) {
+    size_t k = links.size() - 1;
+    
+    while (k > 0 && !isRed(*links[k])) {
+        Node* parent = *links[k - 1];
+        
+        if (links[k] == &parent->left) {
+            Node* sibling = parent->right;
+            if (isRed(sibling)) {
+                sibling->red = false;
+                parent->red = true;
+                rotateLeft(*links[k - 1]);
+                links.insert(links.begin() + k, &sibling->left);
+                ++k;
+                sibling = parent->right;
+            }
+            if (!isRed(sibling->left) && !isRed(sibling->right)) {
+                sibling->red = true;
+                --k;
+                continue;
+            }
+            if (!isRed(sibling->right)) {
+                sibling->left->red = false;
+                sibling->red = true;
+                rotateRight(parent->right);
+                sibling = parent->right;
+            }
+            sibling->red = parent->red;
+            parent->red = false;
+            sibling->right->red = false;
+            rotateLeft(*links[k - 1]);
+        } else {
+            Node* sibling = parent->left;
+            if (isRed(sibling)) {
+                sibling->red = false;
+                parent->red = true;
+                rotateRight(*links[k - 1]);
+                links.insert(links.begin() + k, &sibling->right);
+                ++k;
+                sibling = parent->left;
+            }
+            if (!isRed(sibling->left) && !isRed(sibling->right)) {
+                sibling->red = true;
+                --k;
+                continue;
+            }
+            if (!isRed(sibling->left)) {
+                sibling->right->red = false;
+                sibling->red = true;
+                rotateLeft(parent->left);
+                sibling = parent->left;
+            }
+            sibling->red = parent->red;
+            parent->red = false;
+            sibling->left->red = false;
+            rotateRight(*links[k - 1]);
+        }
+        k = 0;
+    }
+    
+    if (*links[k]) {
+        (*links[k])->red = false;
+    }
+}
+
+template <typename Key, typename Compare, typename Allocator>
+bool BasicBinarySearchTree<Key, Compare, Allocator>::contains(const Key& value) const {
+    // Keys outside [min, max] can't be present, so they skip the descent
+    if (!root || less(value, minValue) || less(maxValue, value)) {
+        return false;
+    }
+    for (const Node* node = root; node; node = childToward(node, value)) {
+        if (equal(value, node->value)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+template <typename Key, typename Compare, typename Allocator>
+bool BasicBinarySearchTree<Key, Compare, Allocator>::search(const Key& value, std::vector<Key>& path) const {
+    path.clear();
+    return visitPath(value, [&path](const Key& key) { path.push_back(key); });
+}
+
+template <typename Key, typename Compare, typename Allocator>
+std::vector<Key> BasicBinarySearchTree<Key, Compare, Allocator>::search(const Key& value) const {
+    std::vector<Key> path;
+    search(value, path);
+    return path;
+}
+
+template <typename Key, typename Compare, typename Allocator>
+void BasicBinarySearchTree<Key, Compare, Allocator>::clear() {
+    // Nodes live in the pool, so dropping its chunks releases the whole tree at once
+    root = nullptr;
+    pool.release();
+}
+
+// New traversal implementations
+template <typename Key, typename Compare, typename Allocator>
+std::vector<Key> BasicBinarySearchTree<Key, Compare, Allocator>::inorderTraversal() const {
+    std::vector<Key> result(size());
+    fillTraversal(root, result.data(), TraversalOrder::Inorder, forkLevels());
+    return result;
+}
+
+template <typename Key, typename Compare, typename Allocator>
+std::vector<Key> BasicBinarySearchTree<Key, Compare, Allocator>::preorderTraversal() const {
+    std::vector<Key> result(size());
+    fillTraversal(root, result.data(), TraversalOrder::Preorder, forkLevels());
+    return result;
+}
+
+template <typename Key, typename Compare, typename Allocator>
+std::vector<Key> BasicBinarySearchTree<Key, Compare, Allocator>::postorderTraversal() const {
+    std::vector<Key> result(size());
+    fillTraversal(root, result.data(), TraversalOrder::Postorder, forkLevels());
+    return result;
+}
+
+// Writes the subtree's keys to out[0, size). Subtree sizes give every key
+// its slot up front, so on large trees the two sides of a node are written
+// in parallel into disjoint ranges of the same buffer.
+template <typename Key, typename Compare, typename Allocator>
+void BasicBinarySearchTree<Key, Compare, Allocator>::fillTraversal(const Node* node, Key* out, TraversalOrder order, int forks) const {
+    if (forks <= 0 || sizeOf(node) < PARALLEL_CUTOFF) {
+        switch (order) {
+        case TraversalOrder::Inorder:
+            traverseInorder(node, out);
+            break;
+        case TraversalOrder::Preorder:
+            traversePreorder(node, out);
+            break;
+        case TraversalOrder::Postorder:
+            traversePostorder(node, out);
+            break;
+        }
+        return;
+    }
+    
+    size_t leftSize = static_cast<size_t>(sizeOf(node->left));
+    Key* leftOut = out;
+    Key* rightOut = out + leftSize;
+    switch (order) {
+    case TraversalOrder::Inorder:
+        out[leftSize] = node->value;
+        rightOut = out + leftSize + 1;
+        break;
+    case TraversalOrder::Preorder:
+        out[0] = node->value;
+        leftOut = out + 1;
+        rightOut = out + leftSize + 1;
+        break;
+    case TraversalOrder::Postorder:
+        out[sizeOf(node) - 1] = node->value;
+        break;
+    }
+    parallelInvoke(true,
+        [&] { fillTraversal(node->left, leftOut, order, forks - 1); },
+        [&] { fillTraversal(node->right, rightOut, order, forks - 1); });
+}
+
+// The traversals keep their pending nodes on a heap-allocated stack rather
+// than the call stack, so a degenerate tree only costs memory, not a crash.
+template <typename Key, typename Compare, typename Allocator>
+void BasicBinarySearchTree<Key, Compare, Allocator>::traverseInorder(const Node* node, Key* out) const {
+    std::vector<const Node*> stack;
+    
+    while (node || !stack.empty()) {
+        while (node) {
+            stack.push_back(node);
+            node = node->left;
+        }
+        node = stack.back();
+        stack.pop_back();
+        *out++ = node->value;
+        node = node->right;
+    }
+}
+
+template <typename Key, typename Compare, typename Allocator>
+void BasicBinarySearchTree<Key, Compare, Allocator>::traversePreorder(const Node* node, Key* out) const {
+    std::vector<const Node*> stack;
+    
+    while (node || !stack.empty()) {
+        if (!node) {
+            node = stack.back();
+            stack.pop_back();
+        }
+        *out++ = node->value;
+        if (node->right) {
+            stack.push_back(node->right);
+        }
+        node = node->left;
+    }
+}
+
+template <typename Key, typename Compare, typename Allocator>
+void BasicBinarySearchTree<Key, Compare, Allocator>::traversePostorder(const Node* node, Key* out) const {
+    std::vector<const Node*> stack;
+    const Node* lastVisited = nullptr;
+    
+    while (node || !stack.empty()) {
+        if (node) {
+            stack.push_back(node);
+            node = node->left;
+            continue;
+        }
+        const Node* top = stack.back();
+        if (top->right && top->right != lastVisited) {
+            node = top->right;
+        } else {
+            *out++ = top->value;
+            lastVisited = top;
+            stack.pop_back();
+        }
+    }
+}
+
+template <typename Key, typename Compare, typename Allocator>
+typename BasicBinarySearchTree<Key, Compare, Allocator>::const_iterator BasicBinarySearchTree<Key, Compare, Allocator>::begin() const {
+    const_iterator it;
+    it.descendLeft(root);
+    return it;
+}
+
+// Both bounds keep every ancestor where the search turned left: those are
+// exactly the nodes still to be visited after the starting one
+template <typename Key, typename Compare, typename Allocator>
+typename BasicBinarySearchTree<Key, Compare, Allocator>::const_iterator BasicBinarySearchTree<Key, Compare, Allocator>::lower_bound(const Key& value) const {
+    const_iterator it;
+    for (const Node* node = root; node; ) {
+        if (!less(node->value, value)) {
+            it.stack.push_back(node);
+            node = node->left;
+        } else {
+            node = node->right;
+        }
+    }
+    return it;
+}
+
+template <typename Key, typename Compare, typename Allocator>
+typename BasicBinarySearchTree<Key, Compare, Allocator>::const_iterator BasicBinarySearchTree<Key, Compare, Allocator>::upper_bound(const Key& value) const {
+    const_iterator it;
+    for (const Node* node = root; node; ) {
+        if (less(value, node->value)) {
+            it.stack.push_back(node);
+            node = node->left;
+        } else {
+            node = node->right;
+        }
+    }
+    return it;
+}
+
+template <typename Key, typename Compare, typename Allocator>
+typename BasicBinarySearchTree<Key, Compare, Allocator>::Range BasicBinarySearchTree<Key, Compare, Allocator>::range(const Key& low, const Key& high) const {
+    if (less(high, low)) {
+        return Range(end(), end());
+    }
+    return Range(lower_bound(low), upper_bound(high));
+}
+
+template <typename Key, typename Compare, typename Allocator>
+size_t BasicBinarySearchTree<Key, Compare, Allocator>::rank(const Key& value) const {
+    return countBelow(value, false);
+}
+
+template <typename Key, typename Compare, typename Allocator>
+size_t BasicBinarySearchTree<Key, Compare, Allocator>::countRange(const Key& low, const Key& high) const {
+    if (less(high, low)) {
+        return 0;
+    }
+    return countBelow(high, true) - countBelow(low, false);
+}
+
+// Counts keys < value (or <= value when inclusive) by adding up the left
+// subtrees the search path skips over
+template <typename Key, typename Compare, typename Allocator>
+size_t BasicBinarySearchTree<Key, Compare, Allocator>::countBelow(const Key& value, bool inclusive) const {
+    size_t count = 0;
+    const Node* node = root;
+    
+    while (node) {
+        if (inclusive ? !less(value, node->value) : less(node->value, value)) {
+            count += sizeOf(node->left) + 1;
+            node = node->right;
+        } else {
+            node = node->left;
+        }
+    }
+    return count;
+}
+
+template <typename Key, typename Compare, typename Allocator>
+const Key& BasicBinarySearchTree<Key, Compare, Allocator>::select(size_t index) const {
+    if (index >= size()) {
+        throw std::out_of_range("select index is past the end of the tree");
+    }
+    
+    const Node* node = root;
+    while (true) {
+        size_t leftSize = sizeOf(node->left);
+        if (index == leftSize) {
+            return node->value;
+        }
+        if (index < leftSize) {
+            node = node->left;
+        } else {
+            index -= leftSize + 1;
+            node = node->right;
+        }
+    }
+}
+
+// Serialization methods
+template <typename Key, typename Compare, typename Allocator>
+std::vector<Key> BasicBinarySearchTree<Key, Compare, Allocator>::serialize() const {
+    return preorderTraversal();  // We use preorder traversal for serialization
+}
+
+template <typename Key, typename Compare, typename Allocator>
+void BasicBinarySearchTree<Key, Compare, Allocator>::deserialize(const std::vector<Key>& nodes) {
+    deserialize(nodes.data(), nodes.size());
+}
+
+template <typename Key, typename Compare, typename Allocator>
+void BasicBinarySearchTree<Key, Compare, Allocator>::deserialize(const Key* nodes, size_t count) {
+    if (policy == BalancePolicy::None) {
+        if (buildFromPreorder(nodes, count)) {
+            return;
+        }
+        // Not a preorder stream (hand-edited or duplicated values): fall back
+        // to the insertion order semantics
+        for (size_t i = 0; i < count; ++i) {
+            insert(nodes[i]);
+        }
+        return;
+    }
+    
+    // Balanced trees only keep the keys, the saved shape may be degenerate
+    std::vector<Key> values;
+    if (isStrictlyIncreasing(nodes, count)) {
+        buildFromSorted(nodes, count);
+        return;
+    }
+    if (buildFromPreorder(nodes, count)) {
+        values = inorderTraversal();
+    } else {
+        values.assign(nodes, nodes + count);
+        std::sort(values.begin(), values.end(), [this](const Key& a, const Key& b) { return less(a, b); });
+        values.erase(std::unique(values.begin(), values.end(), [this](const Key& a, const Key& b) {
+            return equal(a, b);
+        }), values.end());
+    }
+    buildFromSorted(values.data(), values.size());
+}
+
+template <typename Key, typename Compare, typename Allocator>
+void BasicBinarySearchTree<Key, Compare, Allocator>::buildFromSorted(const Key* values, size_t count) {
+    if (!isStrictlyIncreasing(values, count)) {
+        throw std::invalid_argument("buildFromSorted requires strictly increasing values");
+    }
+    
+    clear();
+    if (count == 0) {
+        return;
+    }
+    
+    // Every level but the deepest is full, so colouring just that level red
+    // gives all paths the same black height
+    int deepest = 0;
+    while ((size_t(2) << deepest) <= count) {
+        ++deepest;
+    }
+    pool.reserve(count);
+    root = buildBalanced(values, count, 0, deepest > 0 ? deepest : -1);
+    refreshBounds();
+}
+
+template <typename Key, typename Compare, typename Allocator>
+typename BasicBinarySearchTree<Key, Compare, Allocator>::Node* BasicBinarySearchTree<Key, Compare, Allocator>::buildBalanced(const Key* values, size_t count, int depth, int redDepth) {
+    if (count == 0) {
+        return nullptr;
+    }
+    
+    size_t mid = count / 2;
+    Node* node = pool.allocate(values[mid]);
+    node->red = depth == redDepth;
+    node->left = buildBalanced(values, mid, depth + 1, redDepth);
+    node->right = buildBalanced(values + mid + 1, count - mid - 1, depth + 1, redDepth);
+    update(node);
+    return node;
+}
+
+template <typename Key, typename Compare, typename Allocator>
+bool BasicBinarySearchTree<Key, Compare, Allocator>::buildFromPreorder(const Key* values, size_t count) {
+    clear();
+    if (count == 0) {
+        return true;
+    }
+    
+    // The stack holds the nodes still open for a right child, in decreasing
+    // order. Each value either becomes the left child of the top, or closes
+    // every smaller node and becomes the right child of the last one closed;
+    // that node's value is then a lower bound for everything that follows.
+    pool.reserve(count);
+    std::vector<Node*> stack;
+    root = pool.allocate(values[0]);
+    stack.push_back(root);
+    
+    bool bounded = false;
+    Key lowerBound{};
+    
+    for (size_t i = 1; i < count; ++i) {
+        const Key& value = values[i];
+        if (bounded && !less(lowerBound, value)) {
+            clear();
+            return false;
+        }
+        
+        Node* top = stack.back();
+        if (less(value, top->value)) {
+            top->left = pool.allocate(value);
+            stack.push_back(top->left);
+            continue;
+        }
+        
+        Node* parent = nullptr;
+        while (!stack.empty() && less(stack.back()->value, value)) {
+            parent = stack.back();
+            stack.pop_back();
+        }
+        if (!parent || (!stack.empty() && equal(stack.back()->value, value))) {
+            clear();
+            return false;  // Duplicate value
+        }
+        
+        parent->right = pool.allocate(value);
+        stack.push_back(parent->right);
+        lowerBound = parent->value;
+        bounded = true;
+    }
+    
+    updateSubtree(root);
+    refreshBounds();
+    return true;
+}
+
+template <typename Key, typename Compare, typename Allocator>
+void BasicBinarySearchTree<Key, Compare, Allocator>::DropList::push(Node* subtree) {
+    if (!subtree) {
+        return;
+    }
+    
+    // Flatten the subtree into a chain through `left`, then publish it at once
+    Node* first = subtree;
+    Node* last = subtree;
+    if (subtree->left || subtree->right) {
+        std::vector<Node*> stack{subtree};
+        first = nullptr;
+        last = nullptr;
+        while (!stack.empty()) {
+            Node* node = stack.back();
+            stack.pop_back();
+            if (node->left) {
+                stack.push_back(node->left);
+            }
+            if (node->right) {
+                stack.push_back(node->right);
+            }
+            node->left = first;
+            if (!last) {
+                last = node;
+            }
+            first = node;
+        }
+    }
+    
+    last->left = head.load(std::memory_order_relaxed);
+    while (!head.compare_exchange_weak(last->left, first, std::memory_order_release, std::memory_order_relaxed)) {
+    }
+}
+
+template <typename Key, typename Compare, typename Allocator>
+void BasicBinarySearchTree<Key, Compare, Allocator>::requireBalanced(const char* operation) const {
+    if (policy == BalancePolicy::None) {
+        throw std::logic_error(std::string(operation) + " needs an AVL or red-black tree");
+    }
+}
+
+template <typename Key, typename Compare, typename Allocator>
+BasicBinarySearchTree<Key, Compare, Allocator> BasicBinarySearchTree<Key, Compare, Allocator>::split(const Key& key, bool* found) {
+    requireBalanced("split");
+    
+    BasicBinarySearchTree greater(policy, compare, Allocator(pool.getAllocator()));
+    Part lower;
+    Part upper;
+    Node* match = splitNodes(whole(root), key, lower, upper);
+    if (found) {
+        *found = match != nullptr;
+    }
+    if (match) {
+        pool.deallocate(match);
+    }
+    
+    greater.pool.share(pool, static_cast<size_t>(sizeOf(upper.node)));
+    greater.root = upper.node;
+    root = lower.node;
+    if (policy == BalancePolicy::RedBlack) {
+        if (root) {
+            root->red = false;
+        }
+        if (greater.root) {
+            greater.root->red = false;
+        }
+    }
+    refreshBounds();
+    greater.refreshBounds();
+    return greater;
+}
+
+template <typename Key, typename Compare, typename Allocator>
+BasicBinarySearchTree<Key, Compare, Allocator> BasicBinarySearchTree<Key, Compare, Allocator>::join(
+    BasicBinarySearchTree&& left, const Key& key, BasicBinarySearchTree&& right) {
+    left.requireBalanced("join");
+    if ((!left.isEmpty() && !left.less(left.maxValue, key)) ||
+        (!right.isEmpty() && !left.less(key, right.minValue))) {
+        throw std::invalid_argument("join needs the keys of left < key < the keys of right");
+    }
+    right.setBalancePolicy(left.policy);
+    
+    BasicBinarySearchTree result(std::move(left));
+    result.pool.adopt(right.pool);
+    Node* upper = right.root;
+    right.root = nullptr;
+    
+    Node* middle = result.pool.allocate(key);
+    result.root = result.joinNodes(result.whole(result.root), middle, result.whole(upper)).node;
+    result.refreshBounds();
+    return result;
+}
+
+template <typename Key, typename Compare, typename Allocator>
+void BasicBinarySearchTree<Key, Compare, Allocator>::unionWith(BasicBinarySearchTree&& other) {
+    if (&other == this) {
+        return;
+    }
+    prepareSetOperation(other, "unionWith");
+    DropList dropped;
+    Node* nodes = other.root;
+    other.root = nullptr;
+    finishSetOperation(unionNodes(whole(root), whole(nodes), forkLevels(), dropped).node, dropped);
+}
+
+template <typename Key, typename Compare, typename Allocator>
+void BasicBinarySearchTree<Key, Compare, Allocator>::intersectWith(BasicBinarySearchTree&& other) {
+    if (&other == this) {
+        return;
+    }
+    prepareSetOperation(other, "intersectWith");
+    DropList dropped;
+    Node* nodes = other.root;
+    other.root = nullptr;
+    finishSetOperation(intersectNodes(whole(root), whole(nodes), forkLevels(), dropped).node, dropped);
+}
+
+template <typename Key, typename Compare, typename Allocator>
+void BasicBinarySearchTree<Key, Compare, Allocator>::differenceWith(BasicBinarySearchTree&& other) {
+    if (&other == this) {
+        clear();
+        return;
+    }
+    prepareSetOperation(other, "differenceWith");
+    DropList dropped;
+    Node* nodes = other.root;
+    other.root = nullptr;
+    finishSetOperation(differenceNodes(whole(root), whole(nodes), forkLevels(), dropped).node, dropped);
+}
+
+// Brings `other` to this tree's policy and takes over its nodes, so every
+// node the operation touches belongs to this pool.
+template <typename Key, typename Compare, typename Allocator>
+void BasicBinarySearchTree<Key, Compare, Allocator>::prepareSetOperation(BasicBinarySearchTree& other, const char* operation) {
+    requireBalanced(operation);
+    other.setBalancePolicy(policy);
+    pool.adopt(other.pool);
+}
+
+template <typename Key, typename Compare, typename Allocator>
+void BasicBinarySearchTree<Key, Compare, Allocator>::finishSetOperation(Node* result, DropList& dropped) {
+    root = result;
+    for (Node* node = dropped.take(); node; ) {
+        Node* next = node->left;
+        pool.deallocate(node);
+        node = next;
+    }
+    if (root && policy == BalancePolicy::RedBlack) {
+        root->red = false;
+    }
+    refreshBounds();
+}
+
+// Levels of the recursion that may still fork: enough for about twice as
+// many tasks as threads, so uneven splits still keep every core busy.
+template <typename Key, typename Compare, typename Allocator>
+int BasicBinarySearchTree<Key, Compare, Allocator>::forkLevels() {
+    unsigned threads = WorkStealingPool::instance().size() + 1;
+    int levels = 1;
+    while ((1u << (levels - 1)) < threads) {
+        ++levels;
+    }
+    return threads > 1 ? levels : 0;
+}
+
+template <typename Key, typename Compare, typename Allocator>
+typename BasicBinarySearchTree<Key, Compare, Allocator>::Part BasicBinarySearchTree<Key, Compare, Allocator>::joinNodes(
+    Part left, Node* middle, Part right) const {
+    if (policy == BalancePolicy::RedBlack) {
+        return joinRB(left, middle, right);
+    }
+    return {joinAVL(left.node, middle, right.node), 0};
+}
+
+// Joins two trees without a separating key by pulling the largest key out of
+// `left` to serve as one.
+template <typename Key, typename Compare, typename Allocator>
+typename BasicBinarySearchTree<Key, Compare, Allocator>::Part BasicBinarySearchTree<Key, Compare, Allocator>::joinPair(
+    Part left, Part right) const {
+    if (!left.node) {
+        return right;
+    }
+    if (!right.node) {
+        return left;
+    }
+    const Node* last = left.node;
+    while (last->right) {
+        last = last->right;
+    }
+    Part lower;
+    Part upper;
+    Node* middle = splitNodes(left, last->value, lower, upper);
+    return joinNodes(lower, middle, right);
+}
+
+// Splits the subtree at `node` into the keys below and above `key`,
+// returning the detached node holding `key`, or null. Each level costs one
+// join, and the joined heights telescope to O(log n) in total.
+template <typename Key, typename Compare, typename Allocator>
+typename BasicBinarySearchTree<Key, Compare, Allocator>::Node* BasicBinarySearchTree<Key, Compare, Allocator>::splitNodes(
+    Part node, const Key& key, Part& lower, Part& upper) const {
+    if (!node.node) {
+        lower = {nullptr, 0};
+        upper = {nullptr, 0};
+        return nullptr;
+    }
+    
+    Part left = childOf(node, node.node->left);
+    Part right = childOf(node, node.node->right);
+    if (equal(key, node.node->value)) {
+        lower = left;
+        upper = right;
+        node.node->left = nullptr;
+        node.node->right = nullptr;
+        return node.node;
+    }
+    
+    Node* match;
+    if (less(key, node.node->value)) {
+        match = splitNodes(left, key, lower, upper);
+        upper = joinNodes(upper, node.node, right);
+    } else {
+        match = splitNodes(right, key, lower, upper);
+        lower = joinNodes(left, node.node, lower);
+    }
+    return match;
+}
+
+// The three set operations split one tree by the other's root key, solve
+// both sides independently (in parallel when large enough) and join.
+template <typename Key, typename Compare, typename Allocator>
+typename BasicBinarySearchTree<Key, Compare, Allocator>::Part BasicBinarySearchTree<Key, Compare, Allocator>::unionNodes(
+    Part a, Part b, int forks, DropList& dropped) const {
+    if (!a.node) {
+        return b;
+    }
+    if (!b.node) {
+        return a;
+    }
+    
+    Part lower;
+    Part upper;
+    dropped.push(splitNodes(b, a.node->value, lower, upper));
+    Part aLeft = childOf(a, a.node->left);
+    Part aRight = childOf(a, a.node->right);
+    bool parallel = forks > 0 && sizeOf(a.node) + sizeOf(lower.node) + sizeOf(upper.node) >= PARALLEL_CUTOFF;
+    
+    Part left;
+    Part right;
+    parallelInvoke(parallel,
+        [&] { left = unionNodes(aLeft, lower, forks - 1, dropped); },
+        [&] { right = unionNodes(aRight, upper, forks - 1, dropped); });
+    return joinNodes(left, a.node, right);
+}
+
+template <typename Key, typename Compare, typename Allocator>
+typename BasicBinarySearchTree<Key, Compare, Allocator>::Part BasicBinarySearchTree<Key, Compare, Allocator>::intersectNodes(
+    Part a, Part b, int forks, DropList& dropped) const {
+    if (!a.node || !b.node) {
+        dropped.push(a.node);
+        dropped.push(b.node);
+        return {nullptr, 0};
+    }
+    
+    Part lower;
+    Part upper;
+    Node* match = splitNodes(b, a.node->value, lower, upper);
+    Part aLeft = childOf(a, a.node->left);
+    Part aRight = childOf(a, a.node->right);
+    bool parallel = forks > 0 && sizeOf(a.node) + sizeOf(lower.node) + sizeOf(upper.node) >= PARALLEL_CUTOFF;
+    
+    Part left;
+    Part right;
+    parallelInvoke(parallel,
+        [&] { left = intersectNodes(aLeft, lower, forks - 1, dropped); },
+        [&] { right = intersectNodes(aRight, upper, forks - 1, dropped); });
+    
+    if (match) {
+        dropped.push(match);
+        return joinNodes(left, a.node, right);
+    }
+    a.node->left = nullptr;
+    a.node->right = nullptr;
+    dropped.push(a.node);
+    return joinPair(left, right);
+}
+
+template <typename Key, typename Compare, typename Allocator>
+typename BasicBinarySearchTree<Key, Compare, Allocator>::Part BasicBinarySearchTree<Key, Compare, Allocator>::differenceNodes(
+    Part a, Part b, int forks, DropList& dropped) const {
+    if (!a.node || !b.node) {
+        dropped.push(b.node);
+        return a;
+    }
+    
+    Part lower;
+    Part upper;
+    dropped.push(splitNodes(a, b.node->value, lower, upper));
+    Part bLeft = childOf(b, b.node->left);
+    Part bRight = childOf(b, b.node->right);
+    b.node->left = nullptr;
+    b.node->right = nullptr;
+    bool parallel = forks > 0 && sizeOf(lower.node) + sizeOf(upper.node) + sizeOf(bLeft.node) + sizeOf(bRight.node) >= PARALLEL_CUTOFF;
+    dropped.push(b.node);
+    
+    Part left;
+    Part right;
+    parallelInvoke(parallel,
+        [&] { left = differenceNodes(lower, bLeft, forks - 1, dropped); },
+        [&] { right = differenceNodes(upper, bRight, forks - 1, dropped); });
+    return joinPair(left, right);
+}
+
+// AVL join: descend the taller tree's inner spine to a subtree at most one
+// taller than the other tree, hang both under `middle` there and rebalance
+// back up. Costs O(|height difference| + 1).
+template <typename Key, typename Compare, typename Allocator>
+typename BasicBinarySearchTree<Key, Compare, Allocator>::Node* BasicBinarySearchTree<Key, Compare, Allocator>::joinAVL(
+    Node* left, Node* middle, Node* right) {
+    int leftHeight = heightOf(left);
+    int rightHeight = heightOf(right);
+    if (std::abs(leftHeight - rightHeight) <= 1) {
+        middle->left = left;
+        middle->right = right;
+        update(middle);
+        return middle;
+    }
+    
+    std::vector<Node**> links;
+    Node* root = leftHeight > rightHeight ? left : right;
+    Node** link = &root;
+    if (leftHeight > rightHeight) {
+        while (heightOf(*link) > rightHeight + 1) {
+            links.push_back(link);
+            link = &(*link)->right;
+        }
+        middle->left = *link;
+        middle->right = right;
+    } else {
+        while (heightOf(*link) > leftHeight + 1) {
+            links.push_back(link);
+            link = &(*link)->left;
+        }
+        middle->left = left;
+        middle->right = *link;
+    }
+    update(middle);
+    *link = middle;
+    
+    for (auto it = links.rbegin(); it != links.rend(); ++it) {
+        rebalanceAVL(**it);
+    }
+    return root;
+}
+
+// Red-black join: with both roots black, descend the tree of larger black
+// height to a black node of the other tree's black height, replace it by a
+// red `middle` holding both, and repair red-red violations as an insert
+// would. Both black heights come with the trees and the result's is known
+// from the repair, so a join costs O(|black height difference| + 1).
+template <typename Key, typename Compare, typename Allocator>
+typename BasicBinarySearchTree<Key, Compare, Allocator>::Part BasicBinarySearchTree<Key, Compare, Allocator>::joinRB(
+    Part left, Node* middle, Part right) {
+    if (isRed(left.node)) {
+        left.node->red = false;
+        ++left.black;
+    }
+    if (isRed(right.node)) {
+        right.node->red = false;
+        ++right.black;
+    }
+    if (left.black == right.black) {
+        middle->left = left.node;
+        middle->right = right.node;
+        middle->red = false;
+        update(middle);
+        return {middle, left.black + 1};
+    }
+    
+    bool descendRight = left.black > right.black;
+    int target = std::min(left.black, right.black);
+    int current = std::max(left.black, right.black);
+    int black = current;
+    Node* root = descendRight ? left.node : right.node;
+    std::vector<Node**> links{&root};
+    Node** link = &root;
+    while (isRed(*link) || current != target) {
+        if (!isRed(*link)) {
+            --current;
+        }
+        link = descendRight ? &(*link)->right : &(*link)->left;
+        links.push_back(link);
+    }
+    
+    middle->red = true;
+    middle->left = descendRight ? *link : left.node;
+    middle->right = descendRight ? right.node : *link;
+    update(middle);
+    *link = middle;
+    
+    updateLinks(links);
+    if (insertFixupRB(links)) {
+        ++black;
+    }
+    updateLinks(links);
+    return {root, black};
+}
+
+// Number of black nodes on any path from `node` down to a null link.
+template <typename Key, typename Compare, typename Allocator>
+int BasicBinarySearchTree<Key, Compare, Allocator>::blackHeight(const Node* node) {
+    int height = 0;
+    for (; node; node = node->left) {
+        height += node->red ? 0 : 1;
+    }
+    return height;
+}
+
+#endif // BINARYSEARCHTREE_IMPL_H
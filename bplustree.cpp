@@ -0,0 +1,451 @@
+#include "bplustree.h"
+#include <algorithm>
+#include <climits>
+#include <functional>
+#include <stdexcept>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define BPLUSTREE_SSE2 1
+#endif
+
+BPlusTree::BPlusTree(BPlusTree&& other) noexcept
+    : root(other.root)
+    , count(other.count)
+    , levels(other.levels)
+    , pool(std::move(other.pool))
+{
+    other.root = nullptr;
+    other.count = 0;
+    other.levels = 0;
+}
+
+BPlusTree& BPlusTree::operator=(BPlusTree&& other) noexcept {
+    if (this != &other) {
+        root = other.root;
+        count = other.count;
+        levels = other.levels;
+        pool = std::move(other.pool);
+        other.root = nullptr;
+        other.count = 0;
+        other.levels = 0;
+    }
+    return *this;
+}
+
+// Number of keys in the node smaller than value. Padding slots hold INT_MAX,
+// which is never smaller, so the whole line can be compared at once.
+int BPlusTree::countLess(const Node* node, int value) {
+#ifdef BPLUSTREE_SSE2
+    static_assert(NODE_KEYS == 16, "the SIMD search compares exactly four vectors");
+    const __m128i* line = reinterpret_cast<const __m128i*>(node->keys);
+    __m128i target = _mm_set1_epi32(value);
+    // Each comparison yields -1 per smaller key; sum the four vectors lane-wise,
+    // then fold the lanes
+    __m128i sum = _mm_add_epi32(
+        _mm_add_epi32(_mm_cmplt_epi32(_mm_load_si128(line), target),
+                      _mm_cmplt_epi32(_mm_load_si128(line + 1), target)),
+        _mm_add_epi32(_mm_cmplt_epi32(_mm_load_si128(line + 2), target),
+                      _mm_cmplt_epi32(_mm_load_si128(line + 3), target)));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+    return -_mm_cvtsi128_si32(sum);
+#else
+    int less = 0;
+    for (int i = 0; i < NODE_KEYS; ++i) {
+        less += node->keys[i] < value;
+    }
+    return less;
+#endif
+}
+
+int BPlusTree::childIndex(const Node* node, int value) {
+    int index = countLess(node, value);
+    if (index < node->size && node->keys[index] == value) {
+        ++index;  // A separator is the smallest key of its right subtree
+    }
+    return index;
+}
+
+void BPlusTree::pad(Node* node) {
+    std::fill(node->keys + node->size, node->keys + NODE_KEYS, INT_MAX);
+}
+
+void BPlusTree::insertKey(Node* node, int position, int value) {
+    std::copy_backward(node->keys + position, node->keys + node->size, node->keys + node->size + 1);
+    node->keys[position] = value;
+    ++node->size;
+}
+
+void BPlusTree::eraseKey(Node* node, int position) {
+    std::copy(node->keys + position + 1, node->keys + node->size, node->keys + position);
+    node->keys[--node->size] = INT_MAX;
+}
+
+// Inserts `key` at `position` with `child` as its right-hand child.
+void BPlusTree::insertSeparator(Node* node, int position, int key, Node* child) {
+    std::copy_backward(node->children + position + 1, node->children + node->size + 1,
+                       node->children + node->size + 2);
+    node->children[position + 1] = child;
+    insertKey(node, position, key);
+}
+
+// Removes the key at `position` together with its right-hand child.
+void BPlusTree::eraseSeparator(Node* node, int position) {
+    std::copy(node->children + position + 2, node->children + node->size + 1,
+              node->children + position + 1);
+    eraseKey(node, position);
+}
+
+BPlusTree::Node* BPlusTree::makeNode(bool leaf) {
+    Node* node = pool.allocate();
+    node->size = 0;
+    node->leaf = leaf;
+    node->left = nullptr;
+    node->right = nullptr;
+    pad(node);
+    return node;
+}
+
+void BPlusTree::dropNode(Node* node) {
+    pool.deallocate(node);
+}
+
+bool BPlusTree::contains(int value) const {
+    const Node* node = root;
+    if (!node) {
+        return false;
+    }
+    while (!node->leaf) {
+        node = node->children[childIndex(node, value)];
+    }
+    int index = countLess(node, value);
+    return index < node->size && node->keys[index] == value;
+}
+
+std::vector<int> BPlusTree::search(int value) const {
+    std::vector<int> result;
+    result.reserve(static_cast<size_t>(levels));
+    const Node* node = root;
+
+    while (node) {
+        int index = countLess(node, value);
+        result.push_back(node->keys[std::min(index, node->size - 1)]);
+        if (node->leaf) {
+            break;
+        }
+        node = node->children[childIndex(node, value)];
+    }
+    return result;
+}
+
+bool BPlusTree::insert(int value) {
+    if (!root) {
+        root = makeNode(true);
+        root->keys[0] = value;
+        root->size = 1;
+        count = 1;
+        levels = 1;
+        return true;
+    }
+
+    path.clear();
+    Node* node = root;
+    while (!node->leaf) {
+        int index = childIndex(node, value);
+        path.emplace_back(node, index);
+        node = node->children[index];
+    }
+
+    int position = countLess(node, value);
+    if (position < node->size && node->keys[position] == value) {
+        return false;  // Value already exists
+    }
+    ++count;
+
+    if (node->size < NODE_KEYS) {
+        insertKey(node, position, value);
+        return true;
+    }
+
+    // Full leaf: split it and push the new separator up until a node has room
+    int separator;
+    Node* sibling;
+    splitLeaf(node, position, value, separator, sibling);
+
+    while (!path.empty()) {
+        Node* parent = path.back().first;
+        int index = path.back().second;
+        path.pop_back();
+
+        if (parent->size < NODE_KEYS) {
+            insertSeparator(parent, index, separator, sibling);
+            return true;
+        }
+        splitInner(parent, index, separator, sibling, separator, sibling);
+    }
+
+    Node* newRoot = makeNode(false);
+    newRoot->keys[0] = separator;
+    newRoot->size = 1;
+    newRoot->children[0] = root;
+    newRoot->children[1] = sibling;
+    root = newRoot;
+    ++levels;
+    return true;
+}
+
+void BPlusTree::splitLeaf(Node* leaf, int position, int value, int& separator, Node*& sibling) {
+    int merged[NODE_KEYS + 1];
+    std::copy(leaf->keys, leaf->keys + position, merged);
+    merged[position] = value;
+    std::copy(leaf->keys + position, leaf->keys + NODE_KEYS, merged + position + 1);
+
+    const int leftSize = (NODE_KEYS + 2) / 2;
+    sibling = makeNode(true);
+    std::copy(merged, merged + leftSize, leaf->keys);
+    leaf->size = leftSize;
+    pad(leaf);
+    std::copy(merged + leftSize, merged + NODE_KEYS + 1, sibling->keys);
+    sibling->size = NODE_KEYS + 1 - leftSize;
+
+    sibling->left = leaf;
+    sibling->right = leaf->right;
+    if (leaf->right) {
+        leaf->right->left = sibling;
+    }
+    leaf->right = sibling;
+    separator = sibling->keys[0];
+}
+
+// Splits a full inner node while adding (key, child). The middle key moves up
+// into `separator` and the upper half moves into the new `sibling`.
+void BPlusTree::splitInner(Node* node, int position, int key, Node* child, int& separator, Node*& sibling) {
+    int keys[NODE_KEYS + 1];
+    Node* children[NODE_KEYS + 2];
+    std::copy(node->keys, node->keys + position, keys);
+    keys[position] = key;
+    std::copy(node->keys + position, node->keys + NODE_KEYS, keys + position + 1);
+    std::copy(node->children, node->children + position + 1, children);
+    children[position + 1] = child;
+    std::copy(node->children + position + 1, node->children + NODE_KEYS + 1, children + position + 2);
+
+    const int leftSize = NODE_KEYS / 2;
+    Node* upper = makeNode(false);
+    std::copy(keys, keys + leftSize, node->keys);
+    std::copy(children, children + leftSize + 1, node->children);
+    node->size = leftSize;
+    pad(node);
+
+    std::copy(keys + leftSize + 1, keys + NODE_KEYS + 1, upper->keys);
+    std::copy(children + leftSize + 1, children + NODE_KEYS + 2, upper->children);
+    upper->size = NODE_KEYS - leftSize;
+
+    separator = keys[leftSize];
+    sibling = upper;
+}
+
+bool BPlusTree::remove(int value) {
+    if (!root) {
+        return false;
+    }
+
+    path.clear();
+    Node* node = root;
+    while (!node->leaf) {
+        int index = childIndex(node, value);
+        path.emplace_back(node, index);
+        node = node->children[index];
+    }
+
+    int position = countLess(node, value);
+    if (position >= node->size || node->keys[position] != value) {
+        return false;
+    }
+    eraseKey(node, position);
+    --count;
+
+    // Refill underfull nodes from a sibling, merging when neither can spare a key
+    while (!path.empty() && node->size < MIN_KEYS) {
+        Node* parent = path.back().first;
+        int index = path.back().second;
+        path.pop_back();
+        refill(node, parent, index);
+        node = parent;
+    }
+
+    if (!root->leaf && root->size == 0) {
+        Node* oldRoot = root;
+        root = root->children[0];
+        dropNode(oldRoot);
+        --levels;
+    } else if (root->leaf && root->size == 0) {
+        dropNode(root);
+        root = nullptr;
+        levels = 0;
+    }
+    return true;
+}
+
+// Fixes the underfull child `node` == parent->children[index], either by
+// borrowing one key from a neighbour or by merging with it.
+void BPlusTree::refill(Node* node, Node* parent, int index) {
+    Node* leftSibling = index > 0 ? parent->children[index - 1] : nullptr;
+    Node* rightSibling = index < parent->size ? parent->children[index + 1] : nullptr;
+
+    if (node->leaf) {
+        if (leftSibling && leftSibling->size > MIN_KEYS) {
+            insertKey(node, 0, leftSibling->keys[leftSibling->size - 1]);
+            eraseKey(leftSibling, leftSibling->size - 1);
+            parent->keys[index - 1] = node->keys[0];
+            return;
+        }
+        if (rightSibling && rightSibling->size > MIN_KEYS) {
+            insertKey(node, node->size, rightSibling->keys[0]);
+            eraseKey(rightSibling, 0);
+            parent->keys[index] = rightSibling->keys[0];
+            return;
+        }
+
+        // Merge the right one of the pair into the left one
+        Node* target = leftSibling ? leftSibling : node;
+        Node* source = leftSibling ? node : rightSibling;
+        std::copy(source->keys, source->keys + source->size, target->keys + target->size);
+        target->size += source->size;
+        target->right = source->right;
+        if (source->right) {
+            source->right->left = target;
+        }
+        eraseSeparator(parent, leftSibling ? index - 1 : index);
+        dropNode(source);
+        return;
+    }
+
+    if (leftSibling && leftSibling->size > MIN_KEYS) {
+        // Rotate right through the parent
+        std::copy_backward(node->children, node->children + node->size + 1, node->children + node->size + 2);
+        node->children[0] = leftSibling->children[leftSibling->size];
+        insertKey(node, 0, parent->keys[index - 1]);
+        parent->keys[index - 1] = leftSibling->keys[leftSibling->size - 1];
+        eraseKey(leftSibling, leftSibling->size - 1);
+        return;
+    }
+    if (rightSibling && rightSibling->size > MIN_KEYS) {
+        // Rotate left through the parent
+        node->children[node->size + 1] = rightSibling->children[0];
+        insertKey(node, node->size, parent->keys[index]);
+        parent->keys[index] = rightSibling->keys[0];
+        std::copy(rightSibling->children + 1, rightSibling->children + rightSibling->size + 1,
+                  rightSibling->children);
+        eraseKey(rightSibling, 0);
+        return;
+    }
+
+    // Merge, pulling the separator between the pair down into the left one
+    int separatorIndex = leftSibling ? index - 1 : index;
+    Node* target = leftSibling ? leftSibling : node;
+    Node* source = leftSibling ? node : rightSibling;
+    target->keys[target->size] = parent->keys[separatorIndex];
+    std::copy(source->keys, source->keys + source->size, target->keys + target->size + 1);
+    std::copy(source->children, source->children + source->size + 1, target->children + target->size + 1);
+    target->size += source->size + 1;
+    eraseSeparator(parent, separatorIndex);
+    dropNode(source);
+}
+
+void BPlusTree::clear() {
+    root = nullptr;
+    count = 0;
+    levels = 0;
+    pool.release();
+}
+
+std::vector<int> BPlusTree::inorderTraversal() const {
+    std::vector<int> result;
+    result.reserve(count);
+    const Node* node = root;
+    if (!node) {
+        return result;
+    }
+    while (!node->leaf) {
+        node = node->children[0];
+    }
+    for (; node; node = node->right) {
+        result.insert(result.end(), node->keys, node->keys + node->size);
+    }
+    return result;
+}
+
+void BPlusTree::deserialize(const std::vector<int>& nodes) {
+    if (std::adjacent_find(nodes.begin(), nodes.end(), std::greater_equal<int>()) == nodes.end()) {
+        buildFromSorted(nodes.data(), nodes.size());
+        return;
+    }
+    std::vector<int> values = nodes;
+    std::sort(values.begin(), values.end());
+    values.erase(std::unique(values.begin(), values.end()), values.end());
+    buildFromSorted(values.data(), values.size());
+}
+
+// Packs the keys into as few full leaves as possible, then builds each inner
+// level over the one below. Entries are spread evenly across a level so no
+// node ends up with just a handful of keys.
+void BPlusTree::buildFromSorted(const int* values, size_t total) {
+    if (std::adjacent_find(values, values + total, std::greater_equal<int>()) != values + total) {
+        throw std::invalid_argument("buildFromSorted requires strictly increasing values");
+    }
+    clear();
+    if (total == 0) {
+        return;
+    }
+
+    struct Entry {
+        Node* node;
+        int minKey;
+    };
+    std::vector<Entry> level;
+
+    size_t leafCount = (total + NODE_KEYS - 1) / NODE_KEYS;
+    pool.reserve(leafCount + leafCount / NODE_KEYS + 1);
+    level.reserve(leafCount);
+    Node* previous = nullptr;
+    size_t next = 0;
+    for (size_t i = 0; i < leafCount; ++i) {
+        size_t take = total / leafCount + (i < total % leafCount ? 1 : 0);
+        Node* leaf = makeNode(true);
+        std::copy(values + next, values + next + take, leaf->keys);
+        leaf->size = static_cast<int>(take);
+        leaf->left = previous;
+        if (previous) {
+            previous->right = leaf;
+        }
+        level.push_back({leaf, values[next]});
+        previous = leaf;
+        next += take;
+    }
+    levels = 1;
+
+    while (level.size() > 1) {
+        size_t parentCount = (level.size() + NODE_KEYS) / (NODE_KEYS + 1);
+        std::vector<Entry> parents;
+        parents.reserve(parentCount);
+        size_t child = 0;
+        for (size_t i = 0; i < parentCount; ++i) {
+            size_t take = level.size() / parentCount + (i < level.size() % parentCount ? 1 : 0);
+            Node* node = makeNode(false);
+            node->children[0] = level[child].node;
+            for (size_t j = 1; j < take; ++j) {
+                node->children[j] = level[child + j].node;
+                node->keys[j - 1] = level[child + j].minKey;
+            }
+            node->size = static_cast<int>(take - 1);
+            parents.push_back({node, level[child].minKey});
+            child += take;
+        }
+        level.swap(parents);
+        ++levels;
+    }
+
+    root = level.front().node;
+    count = total;
+}
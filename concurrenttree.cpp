@@ -0,0 +1,359 @@
+#include "concurrenttree.h"
+#include <cstdint>
+#include <limits>
+#include <mutex>
+#include <thread>
+
+namespace {
+
+// Epoch-based reclamation shared by all concurrent trees. Threads announce
+// the global epoch while inside an operation; the epoch only advances once
+// every active thread has seen the current one. Memory retired in epoch e is
+// freed when the global epoch reaches e + 2, by which time no thread can still
+// hold a pointer it read before the node was unlinked.
+class EpochReclaimer {
+public:
+    static EpochReclaimer& instance() {
+        static EpochReclaimer reclaimer;
+        return reclaimer;
+    }
+
+    void enter();
+    void leave();
+    void retire(void* pointer, void (*deleter)(void*));
+
+private:
+    static constexpr uint64_t IDLE = std::numeric_limits<uint64_t>::max();
+    static constexpr size_t COLLECT_THRESHOLD = 128;
+
+    struct Retired {
+        void* pointer;
+        void (*deleter)(void*);
+        uint64_t epoch;
+    };
+
+    // Registry entry for one thread. Slots are never freed, only handed over
+    // to the next thread, so the list can be walked without locking.
+    struct alignas(64) Slot {
+        std::atomic<uint64_t> epoch{IDLE};
+        std::atomic<bool> taken{false};
+        Slot* next = nullptr;
+    };
+
+    struct ThreadState {
+        Slot* slot = nullptr;
+        int depth = 0;
+        std::vector<Retired> retired;
+        ~ThreadState();
+    };
+
+    std::atomic<uint64_t> globalEpoch{0};
+    std::atomic<Slot*> slots{nullptr};
+    std::mutex orphanMutex;
+    std::vector<Retired> orphans;   // Left behind by threads that exited
+
+    EpochReclaimer() = default;
+    ~EpochReclaimer();
+
+    ThreadState& state();
+    Slot* acquireSlot();
+    void tryAdvance();
+    void collect(std::vector<Retired>& list);
+};
+
+EpochReclaimer::~EpochReclaimer() {
+    for (const Retired& item : orphans) {
+        item.deleter(item.pointer);
+    }
+    for (Slot* slot = slots.load(); slot; ) {
+        Slot* next = slot->next;
+        delete slot;
+        slot = next;
+    }
+}
+
+EpochReclaimer::ThreadState::~ThreadState() {
+    if (!slot) {
+        return;
+    }
+    EpochReclaimer& reclaimer = EpochReclaimer::instance();
+    {
+        std::lock_guard<std::mutex> lock(reclaimer.orphanMutex);
+        reclaimer.orphans.insert(reclaimer.orphans.end(), retired.begin(), retired.end());
+    }
+    slot->epoch.store(IDLE);
+    slot->taken.store(false);
+}
+
+EpochReclaimer::ThreadState& EpochReclaimer::state() {
+    thread_local ThreadState local;
+    if (!local.slot) {
+        local.slot = acquireSlot();
+    }
+    return local;
+}
+
+EpochReclaimer::Slot* EpochReclaimer::acquireSlot() {
+    for (Slot* slot = slots.load(); slot; slot = slot->next) {
+        bool expected = false;
+        if (!slot->taken.load() && slot->taken.compare_exchange_strong(expected, true)) {
+            return slot;
+        }
+    }
+
+    auto* slot = new Slot;
+    slot->taken.store(true);
+    slot->next = slots.load();
+    while (!slots.compare_exchange_weak(slot->next, slot)) {
+    }
+    return slot;
+}
+
+void EpochReclaimer::enter() {
+    ThreadState& local = state();
+    if (local.depth++ == 0) {
+        local.slot->epoch.store(globalEpoch.load());
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+    }
+}
+
+void EpochReclaimer::leave() {
+    ThreadState& local = state();
+    if (--local.depth == 0) {
+        local.slot->epoch.store(IDLE, std::memory_order_release);
+    }
+}
+
+void EpochReclaimer::retire(void* pointer, void (*deleter)(void*)) {
+    ThreadState& local = state();
+    local.retired.push_back({pointer, deleter, globalEpoch.load()});
+    if (local.retired.size() < COLLECT_THRESHOLD) {
+        return;
+    }
+
+    tryAdvance();
+    collect(local.retired);
+
+    std::unique_lock<std::mutex> lock(orphanMutex, std::try_to_lock);
+    if (lock.owns_lock() && !orphans.empty()) {
+        collect(orphans);
+    }
+}
+
+void EpochReclaimer::tryAdvance() {
+    uint64_t current = globalEpoch.load();
+    for (Slot* slot = slots.load(); slot; slot = slot->next) {
+        uint64_t epoch = slot->epoch.load();
+        if (epoch != IDLE && epoch != current) {
+            return;  // Someone is still working in an older epoch
+        }
+    }
+    globalEpoch.compare_exchange_strong(current, current + 1);
+}
+
+void EpochReclaimer::collect(std::vector<Retired>& list) {
+    uint64_t current = globalEpoch.load();
+    size_t kept = 0;
+    for (const Retired& item : list) {
+        if (item.epoch + 2 <= current) {
+            item.deleter(item.pointer);
+        } else {
+            list[kept++] = item;
+        }
+    }
+    list.resize(kept);
+}
+
+// Marks the calling thread as active for the duration of one tree operation.
+class EpochGuard {
+public:
+    EpochGuard() { EpochReclaimer::instance().enter(); }
+    ~EpochGuard() { EpochReclaimer::instance().leave(); }
+    EpochGuard(const EpochGuard&) = delete;
+    EpochGuard& operator=(const EpochGuard&) = delete;
+};
+
+} // namespace
+
+void ConcurrentBinarySearchTree::SpinLock::lock() {
+    while (flag.test_and_set(std::memory_order_acquire)) {
+        std::this_thread::yield();
+    }
+}
+
+ConcurrentBinarySearchTree::~ConcurrentBinarySearchTree() {
+    std::vector<Node*> stack;
+    if (Node* root = head.left.load()) {
+        stack.push_back(root);
+    }
+    while (!stack.empty()) {
+        Node* node = stack.back();
+        stack.pop_back();
+        if (Node* left = node->left.load()) {
+            stack.push_back(left);
+        }
+        if (Node* right = node->right.load()) {
+            stack.push_back(right);
+        }
+        delete node;
+    }
+}
+
+ConcurrentBinarySearchTree::Location ConcurrentBinarySearchTree::locate(int value) const {
+    Node* parent = &head;
+    bool leftSide = true;
+    Node* node = head.left.load(std::memory_order_acquire);
+
+    while (node && node->value != value) {
+        parent = node;
+        leftSide = value < node->value;
+        node = node->child(leftSide).load(std::memory_order_acquire);
+    }
+    return {parent, node, leftSide};
+}
+
+bool ConcurrentBinarySearchTree::contains(int value) const {
+    EpochGuard guard;
+    Location location = locate(value);
+    return location.node && !location.node->deleted.load(std::memory_order_acquire);
+}
+
+bool ConcurrentBinarySearchTree::insert(int value) {
+    EpochGuard guard;
+
+    while (true) {
+        Location location = locate(value);
+
+        if (location.node) {
+            // The key is present, possibly as a logically removed routing node
+            Node* node = location.node;
+            std::lock_guard<SpinLock> lock(node->mutex);
+            if (node->unlinked.load(std::memory_order_relaxed)) {
+                continue;  // Removed while we were looking, search again
+            }
+            if (!node->deleted.load(std::memory_order_relaxed)) {
+                return false;
+            }
+            node->deleted.store(false, std::memory_order_release);
+            count.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+
+        Node* parent = location.parent;
+        std::lock_guard<SpinLock> lock(parent->mutex);
+        std::atomic<Node*>& link = parent->child(location.leftSide);
+        if (parent->unlinked.load(std::memory_order_relaxed) || link.load(std::memory_order_relaxed)) {
+            continue;  // The slot changed under us
+        }
+        link.store(new Node(value), std::memory_order_release);
+        count.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+}
+
+bool ConcurrentBinarySearchTree::remove(int value) {
+    EpochGuard guard;
+
+    while (true) {
+        Location location = locate(value);
+        if (!location.node || location.node->deleted.load(std::memory_order_acquire)) {
+            return false;
+        }
+
+        Node* parent = location.parent;
+        Node* node = location.node;
+        bool parentIsRouting = false;
+        {
+            // Locks are always taken parent first, so writers cannot deadlock
+            std::lock_guard<SpinLock> parentLock(parent->mutex);
+            std::lock_guard<SpinLock> nodeLock(node->mutex);
+            std::atomic<Node*>& link = parent->child(location.leftSide);
+            if (parent->unlinked.load(std::memory_order_relaxed) ||
+                link.load(std::memory_order_relaxed) != node ||
+                node->unlinked.load(std::memory_order_relaxed)) {
+                continue;
+            }
+            if (node->deleted.load(std::memory_order_relaxed)) {
+                return false;
+            }
+
+            count.fetch_sub(1, std::memory_order_relaxed);
+            Node* left = node->left.load(std::memory_order_relaxed);
+            Node* right = node->right.load(std::memory_order_relaxed);
+            if (left && right) {
+                node->deleted.store(true, std::memory_order_release);
+                return true;
+            }
+
+            link.store(left ? left : right, std::memory_order_release);
+            node->unlinked.store(true, std::memory_order_relaxed);
+            parentIsRouting = parent != &head && parent->deleted.load(std::memory_order_relaxed);
+        }
+
+        EpochReclaimer::instance().retire(node, &destroyNode);
+        if (parentIsRouting) {
+            unlinkIfRouting(parent->value);
+        }
+        return true;
+    }
+}
+
+// Physically removes a logically deleted node once it is down to one child.
+// Must be called inside an epoch guard.
+void ConcurrentBinarySearchTree::unlinkIfRouting(int value) {
+    while (true) {
+        Location location = locate(value);
+        Node* parent = location.parent;
+        Node* node = location.node;
+        if (!node || !node->deleted.load(std::memory_order_acquire)) {
+            return;
+        }
+
+        {
+            std::lock_guard<SpinLock> parentLock(parent->mutex);
+            std::lock_guard<SpinLock> nodeLock(node->mutex);
+            std::atomic<Node*>& link = parent->child(location.leftSide);
+            if (parent->unlinked.load(std::memory_order_relaxed) ||
+                link.load(std::memory_order_relaxed) != node ||
+                node->unlinked.load(std::memory_order_relaxed)) {
+                continue;
+            }
+
+            Node* left = node->left.load(std::memory_order_relaxed);
+            Node* right = node->right.load(std::memory_order_relaxed);
+            if (!node->deleted.load(std::memory_order_relaxed) || (left && right)) {
+                return;
+            }
+            link.store(left ? left : right, std::memory_order_release);
+            node->unlinked.store(true, std::memory_order_relaxed);
+        }
+
+        EpochReclaimer::instance().retire(node, &destroyNode);
+        return;
+    }
+}
+
+std::vector<int> ConcurrentBinarySearchTree::inorderTraversal() const {
+    EpochGuard guard;
+    std::vector<int> result;
+    std::vector<Node*> stack;
+    Node* node = head.left.load(std::memory_order_acquire);
+
+    while (node || !stack.empty()) {
+        while (node) {
+            stack.push_back(node);
+            node = node->left.load(std::memory_order_acquire);
+        }
+        node = stack.back();
+        stack.pop_back();
+        if (!node->deleted.load(std::memory_order_acquire)) {
+            result.push_back(node->value);
+        }
+        node = node->right.load(std::memory_order_acquire);
+    }
+    return result;
+}
+
+void ConcurrentBinarySearchTree::destroyNode(void* node) {
+    delete static_cast<Node*>(node);
+}
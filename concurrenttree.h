@@ -0,0 +1,76 @@
+#ifndef CONCURRENTTREE_H
+#define CONCURRENTTREE_H
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+// Thread-safe set of integers shaped as an (unbalanced) binary search tree.
+//
+// - contains() takes no locks: it follows atomic child links from the root.
+// - insert() and remove() find their position without locks too, then lock
+//   only the one or two nodes they change and validate that nothing moved in
+//   between, retrying otherwise.
+// - A node with two children is removed logically (flagged, but kept in place
+//   to route searches) and unlinked later once it has at most one child. Keys
+//   therefore never move between nodes, which is what keeps readers lock-free.
+// - Unlinked nodes are freed through epoch-based reclamation, only after
+//   every thread that could still be reading them has left its operation.
+//
+// The destructor and inorderTraversal() expect no concurrent writers.
+class ConcurrentBinarySearchTree {
+public:
+    ConcurrentBinarySearchTree() = default;
+    ~ConcurrentBinarySearchTree();
+    ConcurrentBinarySearchTree(const ConcurrentBinarySearchTree&) = delete;
+    ConcurrentBinarySearchTree& operator=(const ConcurrentBinarySearchTree&) = delete;
+
+    bool insert(int value);
+    bool remove(int value);
+    bool contains(int value) const;
+
+    size_t size() const { return count.load(std::memory_order_relaxed); }
+    bool isEmpty() const { return size() == 0; }
+    std::vector<int> inorderTraversal() const;
+
+private:
+    class SpinLock {
+    public:
+        void lock();
+        void unlock() { flag.clear(std::memory_order_release); }
+
+    private:
+        std::atomic_flag flag = ATOMIC_FLAG_INIT;
+    };
+
+    struct Node {
+        explicit Node(int val) : value(val) {}
+
+        const int value;
+        std::atomic<Node*> left{nullptr};
+        std::atomic<Node*> right{nullptr};
+        std::atomic<bool> deleted{false};    // Logically removed, still routes searches
+        std::atomic<bool> unlinked{false};   // No longer reachable from the root
+        SpinLock mutex;
+
+        std::atomic<Node*>& child(bool leftSide) { return leftSide ? left : right; }
+    };
+
+    // Where a search for a value ended: the node holding it (or null) and the
+    // link of `parent` that pointed there
+    struct Location {
+        Node* parent;
+        Node* node;
+        bool leftSide;
+    };
+
+    // Sentinel above the root; its left link is the root. Its value is never compared.
+    mutable Node head{0};
+    std::atomic<size_t> count{0};
+
+    Location locate(int value) const;
+    void unlinkIfRouting(int value);
+    static void destroyNode(void* node);
+};
+
+#endif // CONCURRENTTREE_H
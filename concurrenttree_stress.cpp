@@ -0,0 +1,129 @@
+// Stress and throughput check for ConcurrentBinarySearchTree.
+//
+// Every thread runs a random mix of insert, remove and contains over the
+// shared tree. Each thread owns the keys congruent to its index modulo the
+// thread count and keeps a reference set of them, so every result on its
+// own keys must match that set exactly while the other threads keep
+// changing the tree around it. Lookups of foreign keys run alongside to
+// exercise the lock-free reads against concurrent unlinking. The final
+// contents must equal the union of the reference sets.
+//
+// Usage: ConcurrentTreeStress [operations per thread] [max threads]
+
+#include "concurrenttree.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <set>
+#include <thread>
+#include <vector>
+
+namespace {
+
+constexpr int KEY_RANGE = 1 << 16;
+
+struct RunResult {
+    bool ok = true;
+    double seconds = 0;
+};
+
+// One thread's share: mixes 20% inserts, 20% removes and 60% lookups
+bool runWorker(ConcurrentBinarySearchTree& tree, unsigned index, unsigned threads, size_t operations,
+               std::atomic<bool>& start, std::set<int>& owned) {
+    std::mt19937 rng(12345u + index);
+    int ownKeys = KEY_RANGE / static_cast<int>(threads);
+    auto ownKey = [&]() { return static_cast<int>(rng() % ownKeys) * static_cast<int>(threads) + static_cast<int>(index); };
+
+    while (!start.load(std::memory_order_acquire)) {
+        std::this_thread::yield();
+    }
+
+    bool ok = true;
+    for (size_t i = 0; i < operations; ++i) {
+        unsigned choice = rng() % 10;
+        if (choice < 2) {
+            int key = ownKey();
+            ok &= tree.insert(key) == owned.insert(key).second;
+        } else if (choice < 4) {
+            int key = ownKey();
+            ok &= tree.remove(key) == (owned.erase(key) == 1);
+        } else if (choice < 7) {
+            int key = ownKey();
+            ok &= tree.contains(key) == (owned.count(key) == 1);
+        } else {
+            tree.contains(static_cast<int>(rng() % KEY_RANGE));
+        }
+    }
+    return ok;
+}
+
+RunResult run(unsigned threads, size_t operations) {
+    ConcurrentBinarySearchTree tree;
+    std::vector<std::set<int>> owned(threads);
+
+    // Start half full so removes and lookups hit as often as they miss
+    std::mt19937 rng(42);
+    for (int i = 0; i < KEY_RANGE / 2; ++i) {
+        int key = static_cast<int>(rng() % KEY_RANGE);
+        unsigned owner = static_cast<unsigned>(key) % threads;
+        if (key / static_cast<int>(threads) < KEY_RANGE / static_cast<int>(threads) && tree.insert(key)) {
+            owned[owner].insert(key);
+        }
+    }
+
+    std::atomic<bool> start{false};
+    std::vector<char> results(threads, 0);
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t]() { results[t] = runWorker(tree, t, threads, operations, start, owned[t]); });
+    }
+    auto begin = std::chrono::steady_clock::now();
+    start.store(true, std::memory_order_release);
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    RunResult result;
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+    std::set<int> expected;
+    for (const std::set<int>& keys : owned) {
+        expected.insert(keys.begin(), keys.end());
+    }
+    std::vector<int> contents = tree.inorderTraversal();
+    result.ok = std::all_of(results.begin(), results.end(), [](char ok) { return ok != 0; }) &&
+                tree.size() == expected.size() &&
+                std::equal(contents.begin(), contents.end(), expected.begin(), expected.end());
+    return result;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    size_t operations = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+    unsigned maxThreads = argc > 2 ? static_cast<unsigned>(std::strtoul(argv[2], nullptr, 10))
+                                   : std::thread::hardware_concurrency();
+    maxThreads = std::max(1u, maxThreads);
+
+    std::vector<unsigned> counts;
+    for (unsigned threads = 1; threads < maxThreads; threads *= 2) {
+        counts.push_back(threads);
+    }
+    counts.push_back(maxThreads);
+
+    std::printf("%8s %14s %10s\n", "threads", "ops/s", "speedup");
+    double baseline = 0;
+    bool ok = true;
+    for (unsigned threads : counts) {
+        RunResult result = run(threads, operations);
+        double rate = static_cast<double>(operations) * threads / result.seconds;
+        if (baseline == 0) {
+            baseline = rate;
+        }
+        std::printf("%8u %14.0f %9.2fx%s\n", threads, rate, rate / baseline, result.ok ? "" : "  MISMATCH");
+        ok &= result.ok;
+    }
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,235 @@
+#include "frozentree.h"
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define FROZENTREE_SSE2 1
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#include <xmmintrin.h>
+#endif
+
+namespace {
+
+inline void prefetch(const void* address) {
+#if defined(__GNUC__) || defined(__clang__)
+    __builtin_prefetch(address);
+#elif defined(_MSC_VER)
+    _mm_prefetch(static_cast<const char*>(address), _MM_HINT_T0);
+#else
+    (void)address;
+#endif
+}
+
+inline int countTrailingZeros(uint64_t x) {
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward64(&index, x);
+    return static_cast<int>(index);
+#else
+    return __builtin_ctzll(x);
+#endif
+}
+
+// An Eytzinger descent encodes its turns in the bits of the final index. The
+// answer is the node where it last went left: drop the trailing right turns
+// (ones) and that left turn (zero). 0 means it never went left.
+inline size_t resolveLowerBound(size_t index) {
+    return index >> (countTrailingZeros(~static_cast<uint64_t>(index)) + 1);
+}
+
+} // namespace
+
+FrozenTree::FrozenTree(const BinarySearchTree& tree) {
+    std::vector<int> sorted = tree.inorderTraversal();
+    layout(sorted.data(), sorted.size());
+
+    // Record the live tree's shape in preorder: push the right child first so
+    // the left child is always the next record
+    struct Pending {
+        const BSTNode* node;
+        size_t parent;      // Record whose right link points here
+        bool isRight;
+    };
+    shape.reserve(count);
+    std::vector<Pending> stack;
+    if (tree.getRoot()) {
+        stack.push_back({tree.getRoot(), 0, false});
+    }
+
+    while (!stack.empty()) {
+        Pending current = stack.back();
+        stack.pop_back();
+
+        size_t index = shape.size();
+        if (current.isRight) {
+            shape[current.parent].right = static_cast<uint32_t>(index);
+        }
+        shape.push_back({current.node->value, 0, current.node->left != nullptr});
+
+        if (current.node->right) {
+            stack.push_back({current.node->right, index, true});
+        }
+        if (current.node->left) {
+            stack.push_back({current.node->left, index, false});
+        }
+    }
+}
+
+FrozenTree FrozenTree::fromSorted(const int* values, size_t count) {
+    if (std::adjacent_find(values, values + count, std::greater_equal<int>()) != values + count) {
+        throw std::invalid_argument("fromSorted requires strictly increasing values");
+    }
+    FrozenTree frozen;
+    frozen.layout(values, count);
+    return frozen;
+}
+
+// Places the sorted keys at their Eytzinger positions 1..n with an inorder
+// walk of the implicit tree.
+void FrozenTree::layout(const int* sorted, size_t total) {
+    count = total;
+    storage.assign(count + 1 + CACHE_LINE_INTS, 0);
+
+    auto address = reinterpret_cast<uintptr_t>(storage.data());
+    size_t misalignment = (address % 64) / sizeof(int);
+    offset = misalignment ? CACHE_LINE_INTS - misalignment : 0;
+
+    int* base = storage.data() + offset;
+    size_t next = 0;
+    std::vector<size_t> stack;
+    size_t k = 1;
+    while (k <= count || !stack.empty()) {
+        while (k <= count) {
+            stack.push_back(k);
+            k = 2 * k;
+        }
+        k = stack.back();
+        stack.pop_back();
+        base[k] = sorted[next++];
+        k = 2 * k + 1;
+    }
+}
+
+size_t FrozenTree::lowerBoundIndex(int value) const {
+    const int* base = keys();
+    size_t k = 1;
+    while (k <= count) {
+        prefetch(base + k * CACHE_LINE_INTS);   // The 16 nodes four levels below k
+        k = 2 * k + (base[k] < value);
+    }
+    return resolveLowerBound(k);
+}
+
+bool FrozenTree::contains(int value) const {
+    size_t k = lowerBoundIndex(value);
+    return k != 0 && keys()[k] == value;
+}
+
+bool FrozenTree::lowerBound(int value, int& result) const {
+    size_t k = lowerBoundIndex(value);
+    if (k == 0) {
+        return false;
+    }
+    result = keys()[k];
+    return true;
+}
+
+void FrozenTree::containsMany(const int* values, size_t total, bool* found) const {
+    const int* base = keys();
+    int levels = 0;
+    while ((size_t(1) << levels) <= count) {
+        ++levels;
+    }
+
+    size_t i = 0;
+#ifdef FROZENTREE_SSE2
+    // Four descents share one register: every level compares all lanes at
+    // once and lanes that already fell off the tree simply stop moving
+    if (count < (size_t(1) << 30)) {
+        const __m128i limit = _mm_set1_epi32(static_cast<int>(count) + 1);
+        for (; i + 4 <= total; i += 4) {
+            __m128i query = _mm_loadu_si128(reinterpret_cast<const __m128i*>(values + i));
+            __m128i index = _mm_set1_epi32(1);
+
+            for (int level = 0; level < levels; ++level) {
+                __m128i active = _mm_cmplt_epi32(index, limit);
+                alignas(16) int lanes[4];
+                _mm_store_si128(reinterpret_cast<__m128i*>(lanes), _mm_and_si128(index, active));
+                __m128i nodes = _mm_setr_epi32(base[lanes[0]], base[lanes[1]], base[lanes[2]], base[lanes[3]]);
+                __m128i goRight = _mm_cmplt_epi32(nodes, query);
+                __m128i next = _mm_sub_epi32(_mm_add_epi32(index, index), goRight);
+                index = _mm_or_si128(_mm_and_si128(active, next), _mm_andnot_si128(active, index));
+            }
+
+            alignas(16) int lanes[4];
+            _mm_store_si128(reinterpret_cast<__m128i*>(lanes), index);
+            for (int lane = 0; lane < 4; ++lane) {
+                size_t k = resolveLowerBound(static_cast<size_t>(lanes[lane]));
+                found[i + lane] = k != 0 && base[k] == values[i + lane];
+            }
+        }
+    }
+#endif
+
+    for (; i < total; ++i) {
+        found[i] = contains(values[i]);
+    }
+}
+
+std::vector<int> FrozenTree::search(int value) const {
+    std::vector<int> path;
+
+    if (shape.empty()) {
+        // No original shape: report the path through the implicit layout
+        const int* base = keys();
+        for (size_t k = 1; k <= count; k = 2 * k + (base[k] < value)) {
+            path.push_back(base[k]);
+            if (base[k] == value) {
+                break;
+            }
+        }
+        return path;
+    }
+
+    size_t index = 0;
+    while (true) {
+        const ShapeNode& node = shape[index];
+        path.push_back(node.value);
+        if (value == node.value) {
+            break;
+        }
+        if (value < node.value) {
+            if (!node.hasLeft) break;
+            index = index + 1;
+        } else {
+            if (!node.right) break;
+            index = node.right;
+        }
+    }
+    return path;
+}
+
+std::vector<int> FrozenTree::inorderTraversal() const {
+    std::vector<int> result;
+    result.reserve(count);
+    const int* base = keys();
+    std::vector<size_t> stack;
+    size_t k = 1;
+
+    while (k <= count || !stack.empty()) {
+        while (k <= count) {
+            stack.push_back(k);
+            k = 2 * k;
+        }
+        k = stack.back();
+        stack.pop_back();
+        result.push_back(base[k]);
+        k = 2 * k + 1;
+    }
+    return result;
+}
@@ -0,0 +1,60 @@
+#ifndef FROZENTREE_H
+#define FROZENTREE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "binarysearchtree.h"
+
+// Read-only snapshot of a BinarySearchTree compiled into flat arrays.
+//
+// Lookups run over the keys in Eytzinger (BFS) order: node k's children sit
+// at 2k and 2k + 1, so the descent is a branchless index computation over
+// one contiguous, cache-line aligned array, and the 16 possible nodes four
+// levels down share one cache line that can be prefetched early.
+//
+// The original tree's shape is kept separately as a preorder array, so
+// search() still reports the same path the live tree would.
+class FrozenTree {
+public:
+    FrozenTree() = default;
+    explicit FrozenTree(const BinarySearchTree& tree);
+
+    // Snapshot of a strictly increasing key array without an original shape;
+    // search() then reports paths through the implicit balanced layout.
+    static FrozenTree fromSorted(const int* values, size_t count);
+
+    bool contains(int value) const;
+    bool lowerBound(int value, int& result) const;   // Smallest key >= value, false if none
+    std::vector<int> search(int value) const;
+
+    // Answers `total` membership queries, advancing four searches in lockstep
+    // so their cache misses overlap.
+    void containsMany(const int* values, size_t total, bool* found) const;
+
+    size_t size() const { return count; }
+    bool isEmpty() const { return count == 0; }
+    std::vector<int> inorderTraversal() const;
+
+private:
+    // Preorder record of the original tree: the left child, if any, is the
+    // next record; `right` is the index of the right child, 0 when absent
+    struct ShapeNode {
+        int value;
+        uint32_t right;
+        bool hasLeft;
+    };
+
+    static constexpr size_t CACHE_LINE_INTS = 64 / sizeof(int);
+
+    std::vector<int> storage;   // Eytzinger keys, padded so keys() is cache-line aligned
+    size_t offset = 0;
+    size_t count = 0;
+    std::vector<ShapeNode> shape;
+
+    const int* keys() const { return storage.data() + offset; }
+    void layout(const int* sorted, size_t total);
+    size_t lowerBoundIndex(int value) const;
+};
+
+#endif // FROZENTREE_H
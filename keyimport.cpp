@@ -0,0 +1,281 @@
+#include "keyimport.h"
+#include "threadpool.h"
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <stdexcept>
+#include <utility>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace {
+
+using Range = std::pair<const char*, const char*>;
+
+constexpr size_t MIN_CHUNK_BYTES = size_t(1) << 20;
+constexpr size_t RADIX_SORT_MIN = size_t(1) << 16;
+constexpr std::uint64_t ONES = 0x0101010101010101ull;
+constexpr std::uint64_t HIGH_BITS = 0x8080808080808080ull;
+constexpr std::uint64_t INT_LIMIT = 2147483648ull;   // Magnitude of INT_MIN
+constexpr std::uint64_t POW10[] = {1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000};
+
+inline int countTrailingZeros(std::uint64_t x) {
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward64(&index, x);
+    return static_cast<int>(index);
+#else
+    return __builtin_ctzll(x);
+#endif
+}
+
+// The next eight input bytes with the first one lowest. Bytes past `end`
+// read as zero, which is a separator.
+inline std::uint64_t loadBytes(const char* p, const char* end) {
+    size_t available = end - p < 8 ? static_cast<size_t>(end - p) : 8;
+    std::uint64_t bytes = 0;
+    if (available == 8) {
+        for (int i = 0; i < 8; ++i) {
+            bytes |= static_cast<std::uint64_t>(static_cast<unsigned char>(p[i])) << (8 * i);
+        }
+        return bytes;
+    }
+    for (size_t i = 0; i < available; ++i) {
+        bytes |= static_cast<std::uint64_t>(static_cast<unsigned char>(p[i])) << (8 * i);
+    }
+    return bytes;
+}
+
+// SWAR: the high bit of every byte that is an ASCII digit. Each byte's
+// comparisons run inside its own eight bits, so no borrow crosses bytes.
+inline std::uint64_t digitMask(std::uint64_t bytes) {
+    std::uint64_t atLeastZero = (bytes | HIGH_BITS) - ONES * '0';
+    std::uint64_t atMostNine = ONES * ('9' | 0x80) - (bytes & ~HIGH_BITS);
+    return atLeastZero & atMostNine & ~bytes & HIGH_BITS;
+}
+
+// Value of the `count` (1..8) digits in the low bytes: pad them to eight
+// digits with leading zeros, then combine neighbouring digits, pairs and
+// quads with three multiplications instead of eight.
+inline std::uint32_t parseDigits(std::uint64_t bytes, int count) {
+    std::uint64_t padding = count == 8 ? 0 : (ONES * '0') >> (8 * count);
+    bytes = (bytes << (8 * (8 - count))) | padding;
+    bytes -= ONES * '0';
+    bytes = bytes * 10 + (bytes >> 8);
+    bytes = ((bytes & 0x000000FF000000FFull) * (100 + (1000000ull << 32)) +
+             ((bytes >> 16) & 0x000000FF000000FFull) * (1 + (10000ull << 32))) >> 32;
+    return static_cast<std::uint32_t>(bytes);
+}
+
+void parseTextChunk(const char* begin, const char* end, ImportResult& out) {
+    const char* p = begin;
+    while (p < end) {
+        std::uint64_t digits = digitMask(loadBytes(p, end));
+        if (!digits) {
+            p += 8;
+            continue;
+        }
+        p += countTrailingZeros(digits) / 8;
+        bool negative = p > begin && p[-1] == '-';
+
+        // Up to eight digits per step; magnitudes past the int range are
+        // clamped so the arithmetic stays within 64 bits
+        std::uint64_t value = 0;
+        int count = 8;
+        while (count == 8) {
+            std::uint64_t bytes = loadBytes(p, end);
+            std::uint64_t separators = ~digitMask(bytes) & HIGH_BITS;
+            count = separators ? countTrailingZeros(separators) / 8 : 8;
+            if (count == 0) {
+                break;
+            }
+            value = std::min(value * POW10[count] + parseDigits(bytes, count), INT_LIMIT + 1);
+            p += count;
+        }
+
+        ++out.parsed;
+        if (value > (negative ? INT_LIMIT : INT_LIMIT - 1)) {
+            ++out.outOfRange;
+            continue;
+        }
+        out.keys.push_back(negative ? static_cast<int>(-static_cast<std::int64_t>(value))
+                                    : static_cast<int>(value));
+    }
+}
+
+// LSD radix sort, one byte per pass, with the sign bit flipped so negative
+// keys order first. Linear in the key count, which beats comparison sorting
+// on the large chunks an import produces.
+void sortKeys(std::vector<int>& keys) {
+    if (keys.size() < RADIX_SORT_MIN) {
+        std::sort(keys.begin(), keys.end());
+        return;
+    }
+
+    std::vector<std::uint32_t> buffer(keys.size());
+    std::vector<std::uint32_t> flipped(keys.size());
+    for (size_t i = 0; i < keys.size(); ++i) {
+        flipped[i] = static_cast<std::uint32_t>(keys[i]) ^ 0x80000000u;
+    }
+    for (int shift = 0; shift < 32; shift += 8) {
+        size_t offsets[256] = {};
+        for (std::uint32_t key : flipped) {
+            ++offsets[(key >> shift) & 0xFF];
+        }
+        size_t total = 0;
+        for (size_t& offset : offsets) {
+            size_t count = offset;
+            offset = total;
+            total += count;
+        }
+        for (std::uint32_t key : flipped) {
+            buffer[offsets[(key >> shift) & 0xFF]++] = key;
+        }
+        flipped.swap(buffer);
+    }
+    for (size_t i = 0; i < keys.size(); ++i) {
+        keys[i] = static_cast<int>(flipped[i] ^ 0x80000000u);
+    }
+}
+
+void parseBinaryChunk(const char* begin, const char* end, ImportResult& out) {
+    size_t count = static_cast<size_t>(end - begin) / 4;
+    out.keys.resize(count);
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(begin);
+    for (size_t i = 0; i < count; ++i, bytes += 4) {
+        std::uint32_t value = static_cast<std::uint32_t>(bytes[0]) | static_cast<std::uint32_t>(bytes[1]) << 8 |
+                              static_cast<std::uint32_t>(bytes[2]) << 16 | static_cast<std::uint32_t>(bytes[3]) << 24;
+        out.keys[i] = static_cast<int>(value);
+    }
+    out.parsed = count;
+}
+
+size_t chunkCount(size_t size) {
+    size_t threads = WorkStealingPool::instance().size() + 1;
+    return std::max<size_t>(1, std::min(size / MIN_CHUNK_BYTES, threads * 4));
+}
+
+// Cuts only between keys: a cut inside a number or right after its minus
+// sign moves forward past the number
+std::vector<Range> splitText(const char* data, size_t size) {
+    std::vector<Range> ranges;
+    size_t chunks = chunkCount(size);
+    const char* end = data + size;
+    const char* start = data;
+    for (size_t i = 1; i <= chunks && start < end; ++i) {
+        const char* cut = std::max(start, data + size / chunks * i);
+        if (i == chunks) {
+            cut = end;
+        }
+        while (cut < end && ((*cut >= '0' && *cut <= '9') || *cut == '-')) {
+            ++cut;
+        }
+        ranges.emplace_back(start, cut);
+        start = cut;
+    }
+    return ranges;
+}
+
+std::vector<Range> splitBinary(const char* data, size_t size) {
+    std::vector<Range> ranges;
+    size_t chunks = chunkCount(size);
+    size_t keys = size / 4;
+    for (size_t i = 0; i < chunks; ++i) {
+        ranges.emplace_back(data + keys * i / chunks * 4, data + keys * (i + 1) / chunks * 4);
+    }
+    return ranges;
+}
+
+std::vector<int> mergeRuns(std::vector<std::vector<int>>& runs, size_t first, size_t last,
+                           ImportProgress* progress) {
+    if (last - first == 1) {
+        return std::move(runs[first]);
+    }
+    if (last == first || (progress && progress->cancelled)) {
+        return std::vector<int>();
+    }
+
+    size_t middle = first + (last - first) / 2;
+    std::vector<int> left;
+    std::vector<int> right;
+    parallelInvoke(true,
+        [&] { left = mergeRuns(runs, first, middle, progress); },
+        [&] { right = mergeRuns(runs, middle, last, progress); });
+
+    // Both runs are strictly increasing, so the union is too
+    std::vector<int> merged;
+    merged.reserve(left.size() + right.size());
+    std::set_union(left.begin(), left.end(), right.begin(), right.end(), std::back_inserter(merged));
+    return merged;
+}
+
+// Parses and sorts every chunk as its own task, then merges the sorted runs
+// pairwise, the independent merges of each level in parallel
+template <typename ParseChunk>
+ImportResult importChunks(const std::vector<Range>& ranges, ImportProgress* progress, ParseChunk parseChunk) {
+    std::vector<ImportResult> parts(ranges.size());
+    TaskGroup group;
+    for (size_t i = 0; i < ranges.size(); ++i) {
+        group.run([&ranges, &parts, progress, parseChunk, i] {
+            if (progress && progress->cancelled) {
+                return;
+            }
+            ImportResult& part = parts[i];
+            parseChunk(ranges[i].first, ranges[i].second, part);
+            sortKeys(part.keys);
+            part.keys.erase(std::unique(part.keys.begin(), part.keys.end()), part.keys.end());
+            if (progress) {
+                progress->bytesDone += static_cast<size_t>(ranges[i].second - ranges[i].first);
+            }
+        });
+    }
+    group.wait();
+
+    ImportResult result;
+    std::vector<std::vector<int>> runs;
+    for (ImportResult& part : parts) {
+        result.parsed += part.parsed;
+        result.outOfRange += part.outOfRange;
+        runs.push_back(std::move(part.keys));
+    }
+    if (!(progress && progress->cancelled)) {
+        result.keys = mergeRuns(runs, 0, runs.size(), progress);
+    }
+    return result;
+}
+
+} // namespace
+
+ImportResult KeyImport::parseText(const char* data, size_t size, ImportProgress* progress) {
+    if (progress) {
+        progress->bytesTotal = size;
+    }
+    return importChunks(splitText(data, size), progress, parseTextChunk);
+}
+
+ImportResult KeyImport::parseBinary(const char* data, size_t size, ImportProgress* progress) {
+    if (size % 4 != 0) {
+        throw std::invalid_argument("Binary key files must hold whole 32-bit integers");
+    }
+    if (progress) {
+        progress->bytesTotal = size;
+    }
+    return importChunks(splitBinary(data, size), progress, parseBinaryChunk);
+}
+
+BinarySearchTree KeyImport::mergeInto(const BinarySearchTree& existing, const std::vector<int>& keys) {
+    BinarySearchTree tree(existing.getBalancePolicy());
+    if (existing.isEmpty()) {
+        tree.buildFromSorted(keys.data(), keys.size());
+        return tree;
+    }
+
+    std::vector<int> current = existing.inorderTraversal();
+    std::vector<int> merged;
+    merged.reserve(current.size() + keys.size());
+    std::set_union(current.begin(), current.end(), keys.begin(), keys.end(), std::back_inserter(merged));
+    tree.buildFromSorted(merged.data(), merged.size());
+    return tree;
+}
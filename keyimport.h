@@ -0,0 +1,42 @@
+#ifndef KEYIMPORT_H
+#define KEYIMPORT_H
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+#include "binarysearchtree.h"
+
+// Shared between an import and whoever shows its progress. bytesDone only
+// counts parsing; the final merge runs once it reaches bytesTotal.
+struct ImportProgress {
+    std::atomic<size_t> bytesDone{0};
+    std::atomic<size_t> bytesTotal{0};
+    std::atomic<bool> cancelled{false};
+};
+
+struct ImportResult {
+    std::vector<int> keys;    // Strictly increasing
+    size_t parsed = 0;        // Numbers read, duplicates included
+    size_t outOfRange = 0;    // Numbers skipped because they don't fit an int
+};
+
+// Bulk loading of keys from an in-memory (typically mapped) file. The input
+// is cut into chunks that are parsed and sorted on the shared work-stealing
+// pool and then merged pairwise, so the result can go straight into a
+// linear-time buildFromSorted.
+class KeyImport {
+public:
+    // Text and CSV: every run of decimal digits is a key, negative when a
+    // '-' comes right before it; all other characters separate keys.
+    static ImportResult parseText(const char* data, size_t size, ImportProgress* progress = nullptr);
+
+    // Raw little-endian int32 keys. Throws std::invalid_argument when the
+    // size is not a multiple of four.
+    static ImportResult parseBinary(const char* data, size_t size, ImportProgress* progress = nullptr);
+
+    // A tree with the existing keys plus the imported ones, built in linear
+    // time with `existing`'s balance policy
+    static BinarySearchTree mergeInto(const BinarySearchTree& existing, const std::vector<int>& keys);
+};
+
+#endif // KEYIMPORT_H
@@ -1,4 +1,6 @@
 #include "mainwindow.h"
+#include "keyimport.h"
+#include "treefile.h"
 #include <QVBoxLayout>
 #include <QHBoxLayout>
 #include <QMessageBox>
@@ -6,11 +8,18 @@
 #include <QMenuBar>
 #include <QToolBar>
 #include <QStatusBar>
+#include <QFile>
 #include <QFileDialog>
 #include <QSettings>
 #include <QRandomGenerator>
 #include <QStyle>
 #include <QApplication>
+#include <QFutureWatcher>
+#include <QProgressDialog>
+#include <QTimer>
+#include <QtConcurrent/QtConcurrentRun>
+#include <algorithm>
+#include <climits>
 
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent)
@@ -51,7 +60,7 @@ void MainWindow::setupUI() {
     headerLayout->addStretch();
     
     // Main controls panel
-    auto* controlsPanel = new QWidget;
+    controlsPanel = new QWidget;
     controlsPanel->setStyleSheet(
         "QWidget {"
         "    background: #f8f9fa;"
@@ -92,7 +101,7 @@ void MainWindow::setupUI() {
     controlsLayout->addWidget(clearButton);
 
     // Advanced controls panel
-    auto* advancedPanel = new QWidget;
+    advancedPanel = new QWidget;
     advancedPanel->setStyleSheet(
         "QWidget {"
         "    background: #f8f9fa;"
@@ -157,6 +166,11 @@ void MainWindow::setupUI() {
     traversalLayout->addWidget(traversalCombo);
     traversalLayout->addWidget(traversalButton);
 
+    // Balancing mode
+    balanceCombo = new QComboBox;
+    balanceCombo->addItems({"Plain BST", "AVL", "Red-Black"});
+    balanceCombo->setStyleSheet(traversalCombo->styleSheet());
+
     // Educational tools
     auto* helpButton = createStyledButton("BST Guide", "#FF5722");
     connect(helpButton, &QPushButton::clicked, this, &MainWindow::showBSTGuide);
@@ -166,6 +180,7 @@ void MainWindow::setupUI() {
 
     advancedLayout->addWidget(randomGroup);
     advancedLayout->addWidget(traversalGroup);
+    advancedLayout->addWidget(balanceCombo);
     advancedLayout->addWidget(helpButton);
     advancedLayout->addWidget(validateButton);
 
@@ -207,6 +222,7 @@ void MainWindow::setupUI() {
     connect(clearButton, &QPushButton::clicked, this, &MainWindow::handleClear);
     connect(randomButton, &QPushButton::clicked, this, &MainWindow::handleRandomInsert);
     connect(traversalButton, &QPushButton::clicked, this, &MainWindow::handleTraversal);
+    connect(balanceCombo, &QComboBox::currentIndexChanged, this, &MainWindow::handleBalanceChanged);
 
     // Set window properties
     resize(1200, 800);
@@ -271,6 +287,8 @@ void MainWindow::showBSTGuide() {
         "<li>Insert: O(log n) average, O(n) worst</li>"
         "<li>Delete: O(log n) average, O(n) worst</li>"
         "</ul>"
+        "<p>Switching the tree to AVL or Red-Black balancing keeps its height "
+        "logarithmic, so every operation is O(log n) in the worst case.</p>"
     );
     overviewText->setWordWrap(true);
     overviewLayout->addWidget(overviewText);
@@ -360,6 +378,10 @@ void MainWindow::createMenuBar() {
     connect(loadAction, &QAction::triggered, this, &MainWindow::handleLoadTree);
     fileMenu->addAction(loadAction);
     
+    auto* importAction = new QAction("&Import Keys...", this);
+    connect(importAction, &QAction::triggered, this, &MainWindow::handleImportKeys);
+    fileMenu->addAction(importAction);
+    
     fileMenu->addSeparator();
     
     auto* exitAction = new QAction("E&xit", this);
@@ -427,8 +449,10 @@ void MainWindow::handleInsert() {
     
     try {
         if (bst->insert(value)) {
+            recordMutation(TreeJournal::Op::Insert, value);
             statusLabel->setText(QString("Inserted %1").arg(value));
             treeVisualizer->updateTree();
+            checkpointIfDue();
         } else {
             statusLabel->setText(QString("%1 already exists in the tree").arg(value));
         }
@@ -450,8 +474,10 @@ void MainWindow::handleDelete() {
     
     try {
         if (bst->remove(value)) {
+            recordMutation(TreeJournal::Op::Remove, value);
             statusLabel->setText(QString("Deleted %1").arg(value));
             treeVisualizer->updateTree();
+            checkpointIfDue();
         } else {
             statusLabel->setText(QString("%1 not found in the tree").arg(value));
         }
@@ -472,13 +498,12 @@ void MainWindow::handleSearch() {
     }
     
     try {
-        auto path = bst->search(value);
-        if (!path.empty() && path.back() == value) {
+        if (bst->search(value, searchPath)) {
             statusLabel->setText(QString("Found %1").arg(value));
-            treeVisualizer->highlightPath(path, QColor(76, 175, 80)); // Material Green 500
+            treeVisualizer->highlightPath(searchPath, QColor(76, 175, 80)); // Material Green 500
         } else {
             statusLabel->setText(QString("%1 not found in the tree").arg(value));
-            treeVisualizer->highlightPath(path, QColor(244, 67, 54)); // Material Red 500
+            treeVisualizer->highlightPath(searchPath, QColor(244, 67, 54)); // Material Red 500
         }
     } catch (const std::exception& e) {
         QMessageBox::critical(this, "Error", QString("Failed to search: %1").arg(e.what()));
@@ -490,8 +515,10 @@ void MainWindow::handleSearch() {
 void MainWindow::handleClear() {
     try {
         bst->clear();
+        recordMutation(TreeJournal::Op::Clear);
         treeVisualizer->updateTree();
         statusLabel->setText("Tree cleared");
+        checkpointIfDue();
     } catch (const std::exception& e) {
         QMessageBox::critical(this, "Error", QString("Failed to clear tree: %1").arg(e.what()));
     }
@@ -501,17 +528,22 @@ void MainWindow::handleClear() {
 
 void MainWindow::handleRandomInsert() {
     int count = randomCountSpinner->value();
-    int inserted = 0;
+    std::vector<int> values(count);
+    for (int& value : values) {
+        value = QRandomGenerator::global()->bounded(1, 100);
+    }
     
-    for (int i = 0; i < count; ++i) {
-        int value = QRandomGenerator::global()->bounded(1, 100);
-        if (bst->insert(value)) {
-            inserted++;
+    auto results = bst->insertBatch(values);
+    int inserted = static_cast<int>(std::count(results.begin(), results.end(), true));
+    for (size_t i = 0; i < values.size(); ++i) {
+        if (results[i]) {
+            recordMutation(TreeJournal::Op::Insert, values[i]);
         }
     }
     
     treeVisualizer->updateTree();
     statusLabel->setText(QString("Inserted %1 random nodes").arg(inserted));
+    checkpointIfDue();
 }
 
 void MainWindow::handleTraversal() {
@@ -555,40 +587,274 @@ void MainWindow::handleTraversal() {
     }
 }
 
+void MainWindow::handleBalanceChanged(int index) {
+    static const BalancePolicy policies[] = {
+        BalancePolicy::None, BalancePolicy::AVL, BalancePolicy::RedBlack
+    };
+    if (index < 0 || index > 2) return;
+    
+    bst->setBalancePolicy(policies[index]);
+    treeVisualizer->updateTree();
+    statusLabel->setText(QString("Balancing: %1").arg(balanceCombo->currentText()));
+}
+
 void MainWindow::handleSaveTree() {
+    // A checkpoint may be writing the document and replacing its journal
+    if (editingLocked) {
+        statusLabel->setText("Please wait for the running task to finish");
+        return;
+    }
+    
     QString fileName = QFileDialog::getSaveFileName(this, "Save Tree", "", "Tree Files (*.tree)");
     if (fileName.isEmpty()) return;
     
-    QSettings settings(fileName, QSettings::IniFormat);
-    auto nodes = bst->serialize();
-    
-    settings.beginWriteArray("nodes");
-    for (size_t i = 0; i < nodes.size(); ++i) {
-        settings.setArrayIndex(static_cast<int>(i));
-        settings.setValue("value", nodes[i]);
+    QString error;
+    if (!TreeFile::save(fileName, *bst, &error)) {
+        QMessageBox::critical(this, "Error", QString("Failed to save tree: %1").arg(error));
+        return;
     }
-    settings.endArray();
-    
+    attachJournal(fileName, true);
     statusLabel->setText("Tree saved successfully");
 }
 
 void MainWindow::handleLoadTree() {
+    if (editingLocked) {
+        statusLabel->setText("Please wait for the running task to finish");
+        return;
+    }
+    
     QString fileName = QFileDialog::getOpenFileName(this, "Load Tree", "", "Tree Files (*.tree)");
     if (fileName.isEmpty()) return;
     
-    QSettings settings(fileName, QSettings::IniFormat);
-    std::vector<int> nodes;
-    
-    int size = settings.beginReadArray("nodes");
-    for (int i = 0; i < size; ++i) {
-        settings.setArrayIndex(i);
-        nodes.push_back(settings.value("value").toInt());
+    if (openTreeFile(fileName)) {
+        statusLabel->setText("Tree loaded successfully");
+    }
+}
+
+// Loads a snapshot plus the changes journaled since it was written, or an
+// old INI save, which has no journal
+bool MainWindow::openTreeFile(const QString& fileName) {
+    if (!TreeFile::isBinary(fileName)) {
+        QSettings settings(fileName, QSettings::IniFormat);
+        std::vector<int> nodes;
+        
+        int size = settings.beginReadArray("nodes");
+        for (int i = 0; i < size; ++i) {
+            settings.setArrayIndex(i);
+            nodes.push_back(settings.value("value").toInt());
+        }
+        settings.endArray();
+        
+        journal = nullptr;
+        documentPath.clear();
+        bst->deserialize(nodes);
+        treeVisualizer->updateTree();
+        return true;
     }
-    settings.endArray();
     
-    bst->deserialize(nodes);
+    QString error;
+    if (!TreeFile::load(fileName, *bst, &error)) {
+        QMessageBox::critical(this, "Error", QString("Failed to load tree: %1").arg(error));
+        return false;
+    }
+    journal = nullptr;
+    try {
+        TreeJournal::replay(QFile::encodeName(fileName + ".journal").toStdString(), *bst);
+    } catch (const std::exception& e) {
+        QMessageBox::warning(this, "Journal", QString("Unsaved changes could not be recovered: %1").arg(e.what()));
+    }
+    attachJournal(fileName, false);
     treeVisualizer->updateTree();
-    statusLabel->setText("Tree loaded successfully");
+    return true;
+}
+
+// Journals further changes against `treeFile`. A snapshot that was just
+// written holds every change so far, so its old journal is emptied.
+void MainWindow::attachJournal(const QString& treeFile, bool snapshotCurrent) {
+    journal = nullptr;
+    documentPath.clear();
+    try {
+        journal = std::make_unique<TreeJournal>(QFile::encodeName(treeFile + ".journal").toStdString());
+        nextCheckpoint = CHECKPOINT_RECORDS;
+        if (snapshotCurrent) {
+            journal->reset();
+        }
+        documentPath = treeFile;
+        QSettings().setValue("lastTree", treeFile);
+    } catch (const std::exception& e) {
+        journal = nullptr;
+        QMessageBox::warning(this, "Journal", QString("Changes will not be saved automatically: %1").arg(e.what()));
+    }
+}
+
+void MainWindow::recordMutation(TreeJournal::Op op, int key) {
+    if (!journal) {
+        return;
+    }
+    try {
+        journal->append(op, key);
+    } catch (const std::exception& e) {
+        journal = nullptr;
+        documentPath.clear();
+        QMessageBox::critical(this, "Error", QString("Failed to journal changes: %1").arg(e.what()));
+    }
+}
+
+// Called once per edit, however many records it journaled
+void MainWindow::checkpointIfDue() {
+    if (journal && !editingLocked && journal->recordCount() >= nextCheckpoint) {
+        checkpoint();
+    }
+}
+
+// Folds the journal into a fresh snapshot so replay stays short. The save
+// walks the whole tree, so it runs on a worker thread and the tree stays
+// read-only until the snapshot is on disk and the journal can be emptied.
+void MainWindow::checkpoint() {
+    setEditingEnabled(false);
+    
+    auto* watcher = new QFutureWatcher<QString>(this);
+    connect(watcher, &QFutureWatcher<QString>::finished, this, [this, watcher]() {
+        QString error = watcher->result();
+        watcher->deleteLater();
+        setEditingEnabled(true);
+        if (!journal) {
+            return;
+        }
+        
+        if (!error.isEmpty()) {
+            nextCheckpoint = journal->recordCount() + CHECKPOINT_RECORDS;
+            statusLabel->setText(QString("Checkpoint failed: %1").arg(error));
+            return;
+        }
+        try {
+            journal->reset();
+            nextCheckpoint = CHECKPOINT_RECORDS;
+        } catch (const std::exception& e) {
+            journal = nullptr;
+            documentPath.clear();
+            QMessageBox::critical(this, "Error", QString("Failed to journal changes: %1").arg(e.what()));
+        }
+    });
+    
+    std::shared_ptr<const BinarySearchTree> tree = bst;
+    QString path = documentPath;
+    watcher->setFuture(QtConcurrent::run([tree, path]() {
+        QString error;
+        return TreeFile::save(path, *tree, &error) ? QString() : error;
+    }));
+}
+
+void MainWindow::handleImportKeys() {
+    if (editingLocked) {
+        statusLabel->setText("Please wait for the running task to finish");
+        return;
+    }
+    
+    QString selectedFilter;
+    QString fileName = QFileDialog::getOpenFileName(this, "Import Keys", "",
+        "Text or CSV files (*.txt *.csv);;Raw int32 files (*.bin);;All files (*)", &selectedFilter);
+    if (fileName.isEmpty()) return;
+    bool binary = selectedFilter.startsWith("Raw") || fileName.endsWith(".bin", Qt::CaseInsensitive);
+    
+    // Parsing, sorting and building all run off the GUI thread; the dialog
+    // polls their progress and can cancel them
+    auto progress = std::make_shared<ImportProgress>();
+    auto* dialog = new QProgressDialog("Importing keys...", "Cancel", 0, 1000, this);
+    dialog->setWindowModality(Qt::WindowModal);
+    dialog->setMinimumDuration(500);
+    dialog->setAutoReset(false);
+    connect(dialog, &QProgressDialog::canceled, this, [progress]() { progress->cancelled = true; });
+    
+    auto* timer = new QTimer(dialog);
+    connect(timer, &QTimer::timeout, dialog, [dialog, progress]() {
+        size_t total = progress->bytesTotal;
+        size_t done = progress->bytesDone;
+        if (total > 0 && done >= total) {
+            dialog->setLabelText("Merging and building the tree...");
+        }
+        dialog->setValue(total > 0 ? static_cast<int>(999.0 * done / total) : 0);
+    });
+    timer->start(100);
+    
+    setEditingEnabled(false);
+    statusLabel->setText("Importing keys...");
+    
+    struct ImportOutcome {
+        std::shared_ptr<BinarySearchTree> tree;
+        size_t parsed = 0;
+        size_t outOfRange = 0;
+        QString error;
+    };
+    
+    auto* watcher = new QFutureWatcher<ImportOutcome>(this);
+    connect(watcher, &QFutureWatcher<ImportOutcome>::finished, this, [this, watcher, dialog, progress]() {
+        ImportOutcome outcome = watcher->result();
+        watcher->deleteLater();
+        dialog->deleteLater();
+        
+        if (!outcome.error.isEmpty()) {
+            setEditingEnabled(true);
+            statusLabel->setText("Import failed");
+            QMessageBox::critical(this, "Error", QString("Failed to import keys: %1").arg(outcome.error));
+            return;
+        }
+        if (progress->cancelled) {
+            setEditingEnabled(true);
+            statusLabel->setText("Import cancelled");
+            return;
+        }
+        
+        size_t added = outcome.tree->size() - bst->size();
+        *bst = std::move(*outcome.tree);
+        treeVisualizer->updateTree();
+        
+        // One snapshot covers the import instead of a journal record per key.
+        // It is written on a worker and editing stays locked until it is done.
+        if (journal) {
+            checkpoint();
+        } else {
+            setEditingEnabled(true);
+        }
+        
+        QString message = QString("Imported %1 keys, %2 new").arg(outcome.parsed).arg(added);
+        if (outcome.outOfRange > 0) {
+            message += QString(", %1 out of range skipped").arg(outcome.outOfRange);
+        }
+        statusLabel->setText(message);
+    });
+    
+    std::shared_ptr<const BinarySearchTree> tree = bst;
+    watcher->setFuture(QtConcurrent::run([fileName, binary, progress, tree]() {
+        ImportOutcome outcome;
+        QFile file(fileName);
+        if (!file.open(QIODevice::ReadOnly)) {
+            outcome.error = file.errorString();
+            return outcome;
+        }
+        size_t size = static_cast<size_t>(file.size());
+        const char* data = nullptr;
+        if (size > 0) {
+            data = reinterpret_cast<const char*>(file.map(0, file.size()));
+            if (!data) {
+                outcome.error = file.errorString();
+                return outcome;
+            }
+        }
+        
+        try {
+            ImportResult result = binary ? KeyImport::parseBinary(data, size, progress.get())
+                                         : KeyImport::parseText(data, size, progress.get());
+            outcome.parsed = result.parsed;
+            outcome.outOfRange = result.outOfRange;
+            if (!progress->cancelled) {
+                outcome.tree = std::make_shared<BinarySearchTree>(KeyImport::mergeInto(*tree, result.keys));
+            }
+        } catch (const std::exception& e) {
+            outcome.error = e.what();
+        }
+        return outcome;
+    }));
 }
 
 void MainWindow::handleZoomIn() {
@@ -602,13 +868,19 @@ void MainWindow::handleZoomOut() {
 }
 
 void MainWindow::handleResetZoom() {
-    treeVisualizer->resetTransform();
+    treeVisualizer->fitToView();
     currentZoom = 1.0;
 }
 
 void MainWindow::loadSettings() {
     QSettings settings;
     restoreGeometry(settings.value("geometry").toByteArray());
+    
+    // Reopen the last tree, replaying whatever it journaled before exit
+    QString lastTree = settings.value("lastTree").toString();
+    if (!lastTree.isEmpty() && QFile::exists(lastTree)) {
+        openTreeFile(lastTree);
+    }
 }
 
 void MainWindow::saveSettings() {
@@ -633,47 +905,51 @@ void MainWindow::validateBST() {
         return;
     }
     
-    bool isValid = true;
-    QString message = "BST Properties:\n\n";
+    // The check walks every node, so run it on a worker thread and keep the
+    // tree read-only until it reports back
+    setEditingEnabled(false);
+    statusLabel->setText("Validating tree...");
+    
+    auto* watcher = new QFutureWatcher<ValidationReport>(this);
+    connect(watcher, &QFutureWatcher<ValidationReport>::finished, this, [this, watcher]() {
+        setEditingEnabled(true);
+        statusLabel->setText("Validation finished");
+        showValidationReport(watcher->result());
+        watcher->deleteLater();
+    });
     
-    // Check BST property
-    std::function<bool(std::shared_ptr<BSTNode>, int, int)> isBST = 
-        [&](std::shared_ptr<BSTNode> node, int min, int max) -> bool {
-            if (!node) return true;
-            
-            if (node->value <= min || node->value >= max)
-                return false;
-            
-            return isBST(node->left, min, node->value) &&
-                   isBST(node->right, node->value, max);
-        };
-    
-    isValid = isBST(bst->getRoot(), INT_MIN, INT_MAX);
-    
-    // Calculate properties
-    std::function<int(std::shared_ptr<BSTNode>)> getHeight = 
-        [&](std::shared_ptr<BSTNode> node) -> int {
-            if (!node) return 0;
-            return 1 + std::max(getHeight(node->left), getHeight(node->right));
-        };
-    
-    std::function<int(std::shared_ptr<BSTNode>)> getSize = 
-        [&](std::shared_ptr<BSTNode> node) -> int {
-            if (!node) return 0;
-            return 1 + getSize(node->left) + getSize(node->right);
-        };
-    
-    int height = getHeight(bst->getRoot());
-    int size = getSize(bst->getRoot());
+    std::shared_ptr<const BinarySearchTree> tree = bst;
+    watcher->setFuture(QtConcurrent::run([tree]() { return tree->validate(); }));
+}
+
+void MainWindow::showValidationReport(const ValidationReport& report) {
+    TreeStats stats = bst->stats();
+    bool isValid = report.ordered && report.consistent && report.balanced;
+    int size = static_cast<int>(report.size);
+    int height = report.height;
     int minHeight = static_cast<int>(std::floor(std::log2(size + 1)));
     int maxHeight = size;
     
+    QString message = "BST Properties:\n\n";
     message += QString("• BST Property: %1\n").arg(isValid ? "Valid ✓" : "Invalid ✗");
+    if (!report.consistent) {
+        message += "• Stored subtree sizes or heights are stale\n";
+    }
+    if (bst->getBalancePolicy() != BalancePolicy::None) {
+        message += QString("• Balancing invariants: %1\n").arg(report.balanced ? "Hold ✓" : "Broken ✗");
+    }
     message += QString("• Height: %1\n").arg(height);
     message += QString("• Number of nodes: %1\n").arg(size);
+    message += QString("• Key range: %1 to %2\n").arg(stats.min).arg(stats.max);
     message += QString("• Minimum possible height: %1\n").arg(minHeight);
     message += QString("• Maximum possible height: %1\n").arg(maxHeight);
     message += QString("• Balance factor: %1\n").arg(maxHeight - height);
     
     QMessageBox::information(this, "BST Validation", message);
 }
+
+void MainWindow::setEditingEnabled(bool enabled) {
+    controlsPanel->setEnabled(enabled);
+    advancedPanel->setEnabled(enabled);
+    editingLocked = !enabled;
+}
@@ -10,6 +10,7 @@
 #include "treevisualizer.h"
 #include <memory>
 #include "binarysearchtree.h"
+#include "treejournal.h"
 
 class MainWindow : public QMainWindow {
     Q_OBJECT
@@ -24,8 +25,10 @@ private slots:
     void handleClear();
     void handleRandomInsert();
     void handleTraversal();
+    void handleBalanceChanged(int index);
     void handleSaveTree();
     void handleLoadTree();
+    void handleImportKeys();
     void handleZoomIn();
     void handleZoomOut();
     void handleResetZoom();
@@ -42,9 +45,19 @@ private:
     QString adjustColor(const QString& color, double factor);
     void showBSTGuide();
     void validateBST();
+    void showValidationReport(const ValidationReport& report);
+    void setEditingEnabled(bool enabled);
+    bool openTreeFile(const QString& fileName);
+    void attachJournal(const QString& treeFile, bool snapshotCurrent);
+    void recordMutation(TreeJournal::Op op, int key = 0);
+    void checkpointIfDue();
+    void checkpoint();
 
     std::shared_ptr<BinarySearchTree> bst;
+    std::vector<int> searchPath;  // Reused by every search
     TreeVisualizer* treeVisualizer;
+    QWidget* controlsPanel;
+    QWidget* advancedPanel;
     QLineEdit* inputField;
     QPushButton* insertButton;
     QPushButton* deleteButton;
@@ -53,10 +66,20 @@ private:
     QPushButton* randomButton;
     QComboBox* traversalCombo;
     QPushButton* traversalButton;
+    QComboBox* balanceCombo;
     QSpinBox* randomCountSpinner;
     QLabel* statusLabel;
     QLabel* logoLabel;
     double currentZoom;
+    bool editingLocked = false;  // A worker thread is reading the tree
+    
+    // Changes since the last snapshot of the open .tree file are journaled
+    // and folded into a new snapshot every CHECKPOINT_RECORDS changes. A
+    // failed snapshot is retried only after another CHECKPOINT_RECORDS.
+    static constexpr size_t CHECKPOINT_RECORDS = 10000;
+    size_t nextCheckpoint = CHECKPOINT_RECORDS;
+    QString documentPath;
+    std::unique_ptr<TreeJournal> journal;
 };
 
 #endif // MAINWINDOW_H
@@ -0,0 +1,166 @@
+#ifndef NODEPOOL_H
+#define NODEPOOL_H
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+// Slab allocator for tree nodes. Nodes are carved out of contiguous chunks and
+// recycled through an intrusive free list threaded through their `left` link,
+// so a tree costs no per-node heap allocation and release() frees everything
+// in one step. Node must be trivially destructible with a `left` pointer member.
+// Chunk memory comes from Allocator, rebound to Node.
+//
+// Chunks are reference counted so that trees built from each other's nodes
+// (split, join, set operations) can share them: share() and adopt() hand
+// nodes between pools, and a chunk is freed once no pool refers to it.
+template <typename Node, typename Allocator = std::allocator<Node>>
+class NodePool {
+    using AllocatorTraits = typename std::allocator_traits<Allocator>::template rebind_traits<Node>;
+    using NodeAllocator = typename AllocatorTraits::allocator_type;
+
+public:
+    explicit NodePool(const Allocator& allocator = Allocator()) : allocator(allocator) {}
+    NodePool(const NodePool&) = delete;
+    NodePool& operator=(const NodePool&) = delete;
+
+    NodePool(NodePool&& other) noexcept
+        : allocator(std::move(other.allocator))
+        , chunks(std::move(other.chunks))
+        , freeList(other.freeList)
+        , next(other.next)
+        , chunkEnd(other.chunkEnd)
+        , liveCount(other.liveCount)
+    {
+        other.release();
+    }
+
+    NodePool& operator=(NodePool&& other) noexcept {
+        if (this != &other) {
+            allocator = std::move(other.allocator);
+            chunks = std::move(other.chunks);
+            freeList = other.freeList;
+            next = other.next;
+            chunkEnd = other.chunkEnd;
+            liveCount = other.liveCount;
+            other.release();
+        }
+        return *this;
+    }
+
+    template <typename... Args>
+    Node* allocate(Args&&... args) {
+        Node* node;
+        if (freeList) {
+            node = freeList;
+            freeList = freeList->left;
+        } else {
+            if (next == chunkEnd) {
+                grow(nextChunkSize());
+            }
+            node = next++;
+        }
+        node = ::new (static_cast<void*>(node)) Node(std::forward<Args>(args)...);
+        ++liveCount;
+        return node;
+    }
+
+    void deallocate(Node* node) {
+        node->left = freeList;
+        freeList = node;
+        --liveCount;
+    }
+
+    // Makes sure the next `count` allocations are served from one contiguous chunk.
+    void reserve(std::size_t count) {
+        if (static_cast<std::size_t>(chunkEnd - next) < count) {
+            grow(count);
+        }
+    }
+
+    // Keeps `other`'s chunks alive here too and takes over `nodes` of its live
+    // nodes, for a tree split off other's tree. Only `other` keeps carving new
+    // nodes out of those chunks.
+    void share(NodePool& other, std::size_t nodes) {
+        mergeChunks(other.chunks);
+        other.liveCount -= nodes;
+        liveCount += nodes;
+    }
+
+    // Takes over all of `other`'s chunks, live nodes and spare nodes, leaving
+    // it empty. Both pools must use interchangeable allocators.
+    void adopt(NodePool& other) {
+        if (this == &other) {
+            return;
+        }
+        mergeChunks(other.chunks);
+        for (Node* node = other.next; node != other.chunkEnd; ++node) {
+            node->left = freeList;
+            freeList = node;
+        }
+        while (Node* node = other.freeList) {
+            other.freeList = node->left;
+            node->left = freeList;
+            freeList = node;
+        }
+        liveCount += other.liveCount;
+        other.release();
+    }
+
+    void release() {
+        chunks.clear();
+        reset();
+    }
+
+    std::size_t size() const { return liveCount; }
+    NodeAllocator getAllocator() const { return allocator; }
+
+private:
+    static constexpr std::size_t MIN_CHUNK_NODES = 256;
+    static constexpr std::size_t MAX_CHUNK_NODES = 64 * 1024;
+
+    struct ChunkDeleter {
+        NodeAllocator allocator;
+        std::size_t count;
+        void operator()(Node* nodes) { AllocatorTraits::deallocate(allocator, nodes, count); }
+    };
+
+    NodeAllocator allocator;
+    std::vector<std::shared_ptr<Node>> chunks;
+    Node* freeList = nullptr;
+    Node* next = nullptr;
+    Node* chunkEnd = nullptr;
+    std::size_t liveCount = 0;
+
+    std::size_t nextChunkSize() const {
+        // Grow geometrically so huge trees need few chunks and tiny ones stay small
+        std::size_t size = MIN_CHUNK_NODES << std::min<std::size_t>(chunks.size(), 8);
+        return std::min(size, MAX_CHUNK_NODES);
+    }
+
+    void grow(std::size_t count) {
+        Node* nodes = AllocatorTraits::allocate(allocator, count);
+        std::shared_ptr<Node> chunk(nodes, ChunkDeleter{allocator, count});
+        chunks.push_back(std::move(chunk));
+        next = nodes;
+        chunkEnd = next + count;
+    }
+
+    void mergeChunks(const std::vector<std::shared_ptr<Node>>& others) {
+        chunks.insert(chunks.end(), others.begin(), others.end());
+        std::sort(chunks.begin(), chunks.end(), std::owner_less<std::shared_ptr<Node>>());
+        chunks.erase(std::unique(chunks.begin(), chunks.end()), chunks.end());
+    }
+
+    void reset() {
+        freeList = nullptr;
+        next = nullptr;
+        chunkEnd = nullptr;
+        liveCount = 0;
+    }
+};
+
+#endif // NODEPOOL_H
@@ -0,0 +1,237 @@
+#include "persistenttree.h"
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <stdexcept>
+
+PersistentTree& PersistentTree::operator=(const PersistentTree& other) {
+    if (this != &other) {
+        publish(other.loadRoot());
+    }
+    return *this;
+}
+
+PersistentTree PersistentTree::fromSorted(const int* values, size_t count) {
+    if (std::adjacent_find(values, values + count, std::greater_equal<int>()) != values + count) {
+        throw std::invalid_argument("fromSorted requires strictly increasing values");
+    }
+    return PersistentTree(buildBalanced(values, count));
+}
+
+PersistentTree::NodePtr PersistentTree::loadRoot() const {
+    return std::atomic_load(&root);
+}
+
+void PersistentTree::publish(NodePtr newRoot) {
+    std::atomic_store(&root, std::move(newRoot));
+}
+
+bool PersistentTree::insert(int value) {
+    bool inserted = false;
+    NodePtr newRoot = insertInto(loadRoot(), value, inserted);
+    if (inserted) {
+        publish(std::move(newRoot));
+    }
+    return inserted;
+}
+
+bool PersistentTree::remove(int value) {
+    bool removed = false;
+    NodePtr newRoot = removeFrom(loadRoot(), value, removed);
+    if (removed) {
+        publish(std::move(newRoot));
+    }
+    return removed;
+}
+
+void PersistentTree::clear() {
+    publish(nullptr);
+}
+
+size_t PersistentTree::size() const {
+    return static_cast<size_t>(sizeOf(loadRoot()));
+}
+
+std::vector<int> PersistentTree::search(int value) const {
+    std::vector<int> path;
+    NodePtr version = loadRoot();
+    const PersistentNode* node = version.get();
+
+    while (node) {
+        path.push_back(node->value);
+        if (value == node->value) {
+            break;
+        }
+        node = value < node->value ? node->left.get() : node->right.get();
+    }
+    return path;
+}
+
+// Traversals hold the version they started from, so a concurrent writer
+// cannot free nodes under them.
+std::vector<int> PersistentTree::inorderTraversal() const {
+    std::vector<int> result;
+    NodePtr version = loadRoot();
+    result.reserve(static_cast<size_t>(sizeOf(version)));
+    std::vector<const PersistentNode*> stack;
+    const PersistentNode* node = version.get();
+
+    while (node || !stack.empty()) {
+        while (node) {
+            stack.push_back(node);
+            node = node->left.get();
+        }
+        node = stack.back();
+        stack.pop_back();
+        result.push_back(node->value);
+        node = node->right.get();
+    }
+    return result;
+}
+
+std::vector<int> PersistentTree::preorderTraversal() const {
+    std::vector<int> result;
+    NodePtr version = loadRoot();
+    result.reserve(static_cast<size_t>(sizeOf(version)));
+    std::vector<const PersistentNode*> stack;
+    if (version) {
+        stack.push_back(version.get());
+    }
+
+    while (!stack.empty()) {
+        const PersistentNode* node = stack.back();
+        stack.pop_back();
+        result.push_back(node->value);
+        if (node->right) {
+            stack.push_back(node->right.get());
+        }
+        if (node->left) {
+            stack.push_back(node->left.get());
+        }
+    }
+    return result;
+}
+
+std::vector<int> PersistentTree::postorderTraversal() const {
+    // Reverse of a root-right-left preorder
+    std::vector<int> result;
+    NodePtr version = loadRoot();
+    result.reserve(static_cast<size_t>(sizeOf(version)));
+    std::vector<const PersistentNode*> stack;
+    if (version) {
+        stack.push_back(version.get());
+    }
+
+    while (!stack.empty()) {
+        const PersistentNode* node = stack.back();
+        stack.pop_back();
+        result.push_back(node->value);
+        if (node->left) {
+            stack.push_back(node->left.get());
+        }
+        if (node->right) {
+            stack.push_back(node->right.get());
+        }
+    }
+    std::reverse(result.begin(), result.end());
+    return result;
+}
+
+PersistentTree::NodePtr PersistentTree::makeNode(int value, NodePtr left, NodePtr right) {
+    int height = 1 + std::max(heightOf(left), heightOf(right));
+    int size = 1 + sizeOf(left) + sizeOf(right);
+    return std::make_shared<const PersistentNode>(
+        PersistentNode{value, height, size, std::move(left), std::move(right)});
+}
+
+// Builds the node (value, left, right), applying the AVL rotations needed
+// when the two sides differ in height by two. Rotations create fresh nodes
+// instead of relinking, since published nodes are shared.
+PersistentTree::NodePtr PersistentTree::balance(int value, NodePtr left, NodePtr right) {
+    int leftHeight = heightOf(left);
+    int rightHeight = heightOf(right);
+
+    if (leftHeight > rightHeight + 1) {
+        if (heightOf(left->left) >= heightOf(left->right)) {
+            return makeNode(left->value, left->left, makeNode(value, left->right, std::move(right)));
+        }
+        const NodePtr& pivot = left->right;
+        return makeNode(pivot->value,
+                        makeNode(left->value, left->left, pivot->left),
+                        makeNode(value, pivot->right, std::move(right)));
+    }
+
+    if (rightHeight > leftHeight + 1) {
+        if (heightOf(right->right) >= heightOf(right->left)) {
+            return makeNode(right->value, makeNode(value, std::move(left), right->left), right->right);
+        }
+        const NodePtr& pivot = right->left;
+        return makeNode(pivot->value,
+                        makeNode(value, std::move(left), pivot->left),
+                        makeNode(right->value, pivot->right, right->right));
+    }
+
+    return makeNode(value, std::move(left), std::move(right));
+}
+
+PersistentTree::NodePtr PersistentTree::insertInto(const NodePtr& node, int value, bool& inserted) {
+    if (!node) {
+        inserted = true;
+        return makeNode(value, nullptr, nullptr);
+    }
+    if (value == node->value) {
+        return node;
+    }
+
+    if (value < node->value) {
+        NodePtr left = insertInto(node->left, value, inserted);
+        return inserted ? balance(node->value, std::move(left), node->right) : node;
+    }
+    NodePtr right = insertInto(node->right, value, inserted);
+    return inserted ? balance(node->value, node->left, std::move(right)) : node;
+}
+
+PersistentTree::NodePtr PersistentTree::removeFrom(const NodePtr& node, int value, bool& removed) {
+    if (!node) {
+        return nullptr;
+    }
+
+    if (value < node->value) {
+        NodePtr left = removeFrom(node->left, value, removed);
+        return removed ? balance(node->value, std::move(left), node->right) : node;
+    }
+    if (value > node->value) {
+        NodePtr right = removeFrom(node->right, value, removed);
+        return removed ? balance(node->value, node->left, std::move(right)) : node;
+    }
+
+    removed = true;
+    if (!node->left) {
+        return node->right;
+    }
+    if (!node->right) {
+        return node->left;
+    }
+    int successor = 0;
+    NodePtr right = removeMin(node->right, successor);
+    return balance(successor, node->left, std::move(right));
+}
+
+PersistentTree::NodePtr PersistentTree::removeMin(const NodePtr& node, int& minValue) {
+    if (!node->left) {
+        minValue = node->value;
+        return node->right;
+    }
+    NodePtr left = removeMin(node->left, minValue);
+    return balance(node->value, std::move(left), node->right);
+}
+
+PersistentTree::NodePtr PersistentTree::buildBalanced(const int* values, size_t count) {
+    if (count == 0) {
+        return nullptr;
+    }
+    size_t mid = count / 2;
+    NodePtr left = buildBalanced(values, mid);
+    NodePtr right = buildBalanced(values + mid + 1, count - mid - 1);
+    return makeNode(values[mid], std::move(left), std::move(right));
+}
@@ -0,0 +1,71 @@
+#ifndef PERSISTENTTREE_H
+#define PERSISTENTTREE_H
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+// Immutable AVL node. Once published a node never changes, so any number of
+// tree versions can share it.
+struct PersistentNode {
+    int value;
+    int height;
+    int size;
+    std::shared_ptr<const PersistentNode> left;
+    std::shared_ptr<const PersistentNode> right;
+};
+
+// Fully persistent search tree. Every insert or remove copies only the
+// O(log n) nodes on the affected path and publishes a new root, sharing all
+// other subtrees with the previous version. Copying a PersistentTree is an
+// O(1) snapshot, which makes undo history cheap and lets readers keep a
+// consistent version for as long as they like.
+//
+// A single writer may mutate a tree while other threads call snapshot() on
+// it: the root is published atomically and nodes are never modified.
+class PersistentTree {
+public:
+    using NodePtr = std::shared_ptr<const PersistentNode>;
+
+    PersistentTree() = default;
+    PersistentTree(const PersistentTree& other) : root(other.loadRoot()) {}
+    PersistentTree& operator=(const PersistentTree& other);
+
+    // Balanced version holding `count` strictly increasing values, built in O(n).
+    static PersistentTree fromSorted(const int* values, size_t count);
+
+    bool insert(int value);
+    bool remove(int value);
+    std::vector<int> search(int value) const;
+    void clear();
+
+    PersistentTree snapshot() const { return *this; }
+
+    std::vector<int> inorderTraversal() const;
+    std::vector<int> preorderTraversal() const;
+    std::vector<int> postorderTraversal() const;
+    std::vector<int> serialize() const { return preorderTraversal(); }
+
+    NodePtr getRoot() const { return loadRoot(); }
+    bool isEmpty() const { return loadRoot() == nullptr; }
+    size_t size() const;
+
+private:
+    NodePtr root;
+
+    explicit PersistentTree(NodePtr root) : root(std::move(root)) {}
+
+    NodePtr loadRoot() const;
+    void publish(NodePtr newRoot);
+
+    static int heightOf(const NodePtr& node) { return node ? node->height : 0; }
+    static int sizeOf(const NodePtr& node) { return node ? node->size : 0; }
+    static NodePtr makeNode(int value, NodePtr left, NodePtr right);
+    static NodePtr balance(int value, NodePtr left, NodePtr right);
+    static NodePtr insertInto(const NodePtr& node, int value, bool& inserted);
+    static NodePtr removeFrom(const NodePtr& node, int value, bool& removed);
+    static NodePtr removeMin(const NodePtr& node, int& minValue);
+    static NodePtr buildBalanced(const int* values, size_t count);
+};
+
+#endif // PERSISTENTTREE_H
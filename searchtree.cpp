@@ -0,0 +1,64 @@
+#include "searchtree.h"
+
+SearchTree::SearchTree(TreeBackend backend, BalancePolicy policy)
+    : tree(backend == TreeBackend::BPlus
+               ? std::variant<BinarySearchTree, BPlusTree>(std::in_place_type<BPlusTree>)
+               : std::variant<BinarySearchTree, BPlusTree>(std::in_place_type<BinarySearchTree>, policy))
+{
+}
+
+bool SearchTree::insert(int value) {
+    return std::visit([value](auto& t) { return t.insert(value); }, tree);
+}
+
+bool SearchTree::remove(int value) {
+    return std::visit([value](auto& t) { return t.remove(value); }, tree);
+}
+
+bool SearchTree::contains(int value) const {
+    return std::visit([value](const auto& t) { return t.contains(value); }, tree);
+}
+
+std::vector<int> SearchTree::search(int value) const {
+    return std::visit([value](const auto& t) { return t.search(value); }, tree);
+}
+
+void SearchTree::clear() {
+    std::visit([](auto& t) { t.clear(); }, tree);
+}
+
+std::vector<int> SearchTree::inorderTraversal() const {
+    return std::visit([](const auto& t) { return t.inorderTraversal(); }, tree);
+}
+
+std::vector<int> SearchTree::preorderTraversal() const {
+    return std::visit([](const auto& t) { return t.preorderTraversal(); }, tree);
+}
+
+std::vector<int> SearchTree::postorderTraversal() const {
+    return std::visit([](const auto& t) { return t.postorderTraversal(); }, tree);
+}
+
+std::vector<int> SearchTree::serialize() const {
+    return std::visit([](const auto& t) { return t.serialize(); }, tree);
+}
+
+void SearchTree::deserialize(const std::vector<int>& nodes) {
+    std::visit([&nodes](auto& t) { t.deserialize(nodes); }, tree);
+}
+
+void SearchTree::buildFromSorted(const int* values, size_t count) {
+    std::visit([values, count](auto& t) { t.buildFromSorted(values, count); }, tree);
+}
+
+bool SearchTree::isEmpty() const {
+    return std::visit([](const auto& t) { return t.isEmpty(); }, tree);
+}
+
+size_t SearchTree::size() const {
+    return std::visit([](const auto& t) { return t.size(); }, tree);
+}
+
+TreeBackend SearchTree::getBackend() const {
+    return std::holds_alternative<BPlusTree>(tree) ? TreeBackend::BPlus : TreeBackend::Binary;
+}
@@ -0,0 +1,48 @@
+#ifndef SEARCHTREE_H
+#define SEARCHTREE_H
+
+#include <variant>
+#include <vector>
+#include "binarysearchtree.h"
+#include "bplustree.h"
+
+// Node layout behind a SearchTree.
+enum class TreeBackend {
+    Binary,     // BinarySearchTree, one key per node, can be visualized
+    BPlus       // BPlusTree, cache-line-wide nodes for large key sets
+};
+
+// Integer set whose storage backend is chosen at construction time. Every
+// call is forwarded to the selected tree without virtual dispatch.
+class SearchTree {
+public:
+    explicit SearchTree(TreeBackend backend = TreeBackend::Binary,
+                        BalancePolicy policy = BalancePolicy::None);
+
+    bool insert(int value);
+    bool remove(int value);
+    bool contains(int value) const;
+    std::vector<int> search(int value) const;
+    void clear();
+
+    std::vector<int> inorderTraversal() const;
+    std::vector<int> preorderTraversal() const;
+    std::vector<int> postorderTraversal() const;
+
+    std::vector<int> serialize() const;
+    void deserialize(const std::vector<int>& nodes);
+    void buildFromSorted(const int* values, size_t count);
+
+    bool isEmpty() const;
+    size_t size() const;
+
+    TreeBackend getBackend() const;
+
+    // The binary tree for drawing, or nullptr on the B+-tree backend.
+    const BinarySearchTree* binaryTree() const { return std::get_if<BinarySearchTree>(&tree); }
+
+private:
+    std::variant<BinarySearchTree, BPlusTree> tree;
+};
+
+#endif // SEARCHTREE_H
@@ -0,0 +1,154 @@
+#include "threadpool.h"
+#include <chrono>
+
+namespace {
+
+// Which pool and deque the current thread works for, if any
+thread_local const WorkStealingPool* workerPool = nullptr;
+thread_local size_t workerIndex = 0;
+
+} // namespace
+
+WorkStealingPool& WorkStealingPool::instance() {
+    static WorkStealingPool pool(std::thread::hardware_concurrency() > 1
+                                     ? std::thread::hardware_concurrency() - 1 : 0);
+    return pool;
+}
+
+WorkStealingPool::WorkStealingPool(unsigned workers) {
+    for (unsigned i = 0; i <= workers; ++i) {
+        queues.push_back(std::make_unique<Queue>());
+    }
+    threads.reserve(workers);
+    for (unsigned i = 0; i < workers; ++i) {
+        threads.emplace_back(&WorkStealingPool::workerLoop, this, i);
+    }
+}
+
+WorkStealingPool::~WorkStealingPool() {
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        stopping.store(true);
+    }
+    wake.notify_all();
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+}
+
+size_t WorkStealingPool::currentQueue() const {
+    return workerPool == this ? workerIndex : threads.size();
+}
+
+void WorkStealingPool::submit(Task task) {
+    Queue& queue = *queues[currentQueue()];
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.tasks.push_back(std::move(task));
+    }
+    queued.fetch_add(1);
+
+    // Taking the lock orders this wakeup after a worker's last look at `queued`
+    std::lock_guard<std::mutex> lock(sleepMutex);
+    wake.notify_one();
+}
+
+bool WorkStealingPool::popLocal(size_t index, Task& task) {
+    Queue& queue = *queues[index];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.tasks.empty()) {
+        return false;
+    }
+    task = std::move(queue.tasks.back());
+    queue.tasks.pop_back();
+    return true;
+}
+
+bool WorkStealingPool::steal(size_t thief, Task& task) {
+    size_t count = queues.size();
+    for (size_t offset = 1; offset <= count; ++offset) {
+        Queue& queue = *queues[(thief + offset) % count];
+        std::unique_lock<std::mutex> lock(queue.mutex, std::try_to_lock);
+        if (!lock.owns_lock() || queue.tasks.empty()) {
+            continue;
+        }
+        task = std::move(queue.tasks.front());
+        queue.tasks.pop_front();
+        return true;
+    }
+    return false;
+}
+
+bool WorkStealingPool::runPendingTask() {
+    size_t index = currentQueue();
+    Task task;
+    if (!popLocal(index, task) && !steal(index, task)) {
+        return false;
+    }
+    queued.fetch_sub(1);
+    task();
+    return true;
+}
+
+void WorkStealingPool::workerLoop(size_t index) {
+    workerPool = this;
+    workerIndex = index;
+
+    while (true) {
+        if (runPendingTask()) {
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        if (stopping.load()) {
+            return;
+        }
+        if (queued.load() == 0) {
+            // The timeout covers tasks a try_lock steal skipped over
+            wake.wait_for(lock, std::chrono::milliseconds(10));
+        }
+    }
+}
+
+TaskGroup::~TaskGroup() {
+    while (pending.load() != 0) {
+        if (!pool.runPendingTask()) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+void TaskGroup::run(std::function<void()> task) {
+    auto guarded = [this, task = std::move(task)] {
+        try {
+            task();
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(errorMutex);
+            if (!error) {
+                error = std::current_exception();
+            }
+        }
+        pending.fetch_sub(1);
+    };
+
+    if (pool.size() == 0) {
+        pending.fetch_add(1);
+        guarded();
+        return;
+    }
+    pending.fetch_add(1);
+    pool.submit(std::move(guarded));
+}
+
+void TaskGroup::wait() {
+    while (pending.load() != 0) {
+        if (!pool.runPendingTask()) {
+            std::this_thread::yield();
+        }
+    }
+    std::lock_guard<std::mutex> lock(errorMutex);
+    if (error) {
+        std::exception_ptr thrown = error;
+        error = nullptr;
+        std::rethrow_exception(thrown);
+    }
+}
@@ -0,0 +1,96 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads for fork-join work. Each worker owns a deque:
+// it pushes and pops its own tasks at the back (newest first, so a recursive
+// split stays depth-first and cache-warm) while idle workers steal from the
+// front of other deques, taking the oldest and thus largest pieces of work.
+// Tasks submitted from outside the pool go to a shared injection deque.
+class WorkStealingPool {
+public:
+    using Task = std::function<void()>;
+
+    // Shared pool with one worker per hardware thread beyond the caller's
+    static WorkStealingPool& instance();
+
+    explicit WorkStealingPool(unsigned workers);
+    ~WorkStealingPool();
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    unsigned size() const { return static_cast<unsigned>(threads.size()); }
+
+    void submit(Task task);
+
+    // Runs one queued task on the calling thread, if there is any. Threads
+    // waiting for their own tasks call this so they help instead of blocking.
+    bool runPendingTask();
+
+private:
+    struct alignas(64) Queue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    std::vector<std::unique_ptr<Queue>> queues;   // One per worker, then the injection queue
+    std::vector<std::thread> threads;
+    std::atomic<size_t> queued{0};
+    std::atomic<bool> stopping{false};
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+
+    bool popLocal(size_t index, Task& task);
+    bool steal(size_t thief, Task& task);
+    void workerLoop(size_t index);
+    size_t currentQueue() const;
+};
+
+// Fork-join scope on a pool. run() queues a task, wait() returns once every
+// task of the group has finished, executing pending work meanwhile, and
+// rethrows the first exception a task threw. With no workers run() simply
+// calls the task.
+class TaskGroup {
+public:
+    explicit TaskGroup(WorkStealingPool& pool = WorkStealingPool::instance()) : pool(pool) {}
+    ~TaskGroup();
+    TaskGroup(const TaskGroup&) = delete;
+    TaskGroup& operator=(const TaskGroup&) = delete;
+
+    void run(std::function<void()> task);
+    void wait();
+
+private:
+    WorkStealingPool& pool;
+    std::atomic<size_t> pending{0};
+    std::mutex errorMutex;
+    std::exception_ptr error;
+};
+
+// Runs `first` and `second` as two halves of a fork-join step: `first` is
+// offered to the pool while the caller runs `second`. When `parallel` is
+// false both simply run in order on the caller.
+template <typename First, typename Second>
+void parallelInvoke(bool parallel, First&& first, Second&& second) {
+    if (!parallel || WorkStealingPool::instance().size() == 0) {
+        first();
+        second();
+        return;
+    }
+    TaskGroup group;
+    group.run([&first] { first(); });
+    second();
+    group.wait();
+}
+
+#endif // THREADPOOL_H
@@ -0,0 +1,300 @@
+#include "treecodec.h"
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+namespace {
+
+const char MAGIC[4] = {'B', 'S', 'T', 'Z'};
+constexpr std::uint8_t VERSION = 1;
+constexpr size_t HEADER_SIZE = 8;
+constexpr size_t INDEX_ENTRY_SIZE = 12;
+constexpr size_t TRAILER_SIZE = 20;
+
+void appendVarint(std::vector<std::uint8_t>& out, std::uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<std::uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<std::uint8_t>(value));
+}
+
+std::uint64_t readVarint(const std::uint8_t*& cursor, const std::uint8_t* end) {
+    std::uint64_t value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (cursor == end) {
+            throw std::runtime_error("Tree stream ends inside a number");
+        }
+        std::uint8_t byte = *cursor++;
+        value |= static_cast<std::uint64_t>(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            return value;
+        }
+    }
+    throw std::runtime_error("Tree stream has an overlong number");
+}
+
+// Zigzag maps small differences of either sign to small unsigned numbers
+std::uint64_t zigzag(std::int64_t value) {
+    return (static_cast<std::uint64_t>(value) << 1) ^ static_cast<std::uint64_t>(value >> 63);
+}
+
+std::int64_t unzigzag(std::uint64_t value) {
+    return static_cast<std::int64_t>(value >> 1) ^ -static_cast<std::int64_t>(value & 1);
+}
+
+void appendFixed(std::vector<std::uint8_t>& out, std::uint64_t value, int bytes) {
+    for (int i = 0; i < bytes; ++i) {
+        out.push_back(static_cast<std::uint8_t>(value >> (8 * i)));
+    }
+}
+
+std::uint64_t readFixed(const std::uint8_t* data, int bytes) {
+    std::uint64_t value = 0;
+    for (int i = 0; i < bytes; ++i) {
+        value |= static_cast<std::uint64_t>(data[i]) << (8 * i);
+    }
+    return value;
+}
+
+} // namespace
+
+TreeEncoder::TreeEncoder(Sink sink, TreeFileLayout order)
+    : sink(std::move(sink))
+{
+    std::uint8_t header[HEADER_SIZE] = {};
+    std::memcpy(header, MAGIC, sizeof(MAGIC));
+    header[4] = VERSION;
+    header[5] = static_cast<std::uint8_t>(order);
+    write(header, sizeof(header));
+}
+
+void TreeEncoder::push(int key) {
+    if (finished) {
+        throw std::logic_error("push after finish");
+    }
+    if (blockKeys == 0) {
+        index.push_back({written, key});
+        appendVarint(payload, zigzag(key));
+    } else {
+        appendVarint(payload, zigzag(static_cast<std::int64_t>(key) - previous));
+    }
+    previous = key;
+    ++total;
+    if (++blockKeys == BLOCK_KEYS) {
+        flushBlock();
+    }
+}
+
+void TreeEncoder::flushBlock() {
+    if (blockKeys == 0) {
+        return;
+    }
+    std::vector<std::uint8_t> header;
+    appendVarint(header, blockKeys);
+    appendVarint(header, payload.size());
+    write(header.data(), header.size());
+    write(payload.data(), payload.size());
+    payload.clear();
+    blockKeys = 0;
+}
+
+void TreeEncoder::finish() {
+    if (finished) {
+        return;
+    }
+    flushBlock();
+
+    std::vector<std::uint8_t> tail;
+    appendVarint(tail, 0);
+    std::uint64_t indexOffset = written + tail.size();
+    for (const IndexEntry& entry : index) {
+        appendFixed(tail, entry.offset, 8);
+        appendFixed(tail, static_cast<std::uint32_t>(entry.firstKey), 4);
+    }
+    appendFixed(tail, indexOffset, 8);
+    appendFixed(tail, total, 8);
+    tail.insert(tail.end(), MAGIC, MAGIC + sizeof(MAGIC));
+    write(tail.data(), tail.size());
+    finished = true;
+}
+
+void TreeEncoder::write(const std::uint8_t* data, size_t size) {
+    sink(data, size);
+    written += size;
+}
+
+void TreeEncoder::encode(const BinarySearchTree& tree, Sink sink) {
+    if (tree.getBalancePolicy() != BalancePolicy::None) {
+        TreeEncoder encoder(std::move(sink), TreeFileLayout::Sorted);
+        for (int key : tree) {
+            encoder.push(key);
+        }
+        encoder.finish();
+        return;
+    }
+
+    TreeEncoder encoder(std::move(sink), TreeFileLayout::Preorder);
+    std::vector<const BSTNode*> stack;
+    const BSTNode* node = tree.getRoot();
+    while (node || !stack.empty()) {
+        if (!node) {
+            node = stack.back();
+            stack.pop_back();
+        }
+        encoder.push(node->value);
+        if (node->right) {
+            stack.push_back(node->right);
+        }
+        node = node->left;
+    }
+    encoder.finish();
+}
+
+TreeDecoder::TreeDecoder(const std::uint8_t* data, size_t size)
+    : data(data)
+{
+    if (size < HEADER_SIZE + 1 + TRAILER_SIZE ||
+        std::memcmp(data, MAGIC, sizeof(MAGIC)) != 0 ||
+        std::memcmp(data + size - sizeof(MAGIC), MAGIC, sizeof(MAGIC)) != 0) {
+        throw std::runtime_error("Not a tree stream");
+    }
+    if (data[4] != VERSION) {
+        throw std::runtime_error("Unsupported tree stream version");
+    }
+    if (data[5] > static_cast<std::uint8_t>(TreeFileLayout::Sorted)) {
+        throw std::runtime_error("Unknown key order in tree stream");
+    }
+    keyOrder = static_cast<TreeFileLayout>(data[5]);
+
+    const std::uint8_t* trailer = data + size - TRAILER_SIZE;
+    std::uint64_t indexOffset = readFixed(trailer, 8);
+    std::uint64_t keys = readFixed(trailer + 8, 8);
+    if (indexOffset < HEADER_SIZE + 1 || indexOffset > static_cast<std::uint64_t>(trailer - data)) {
+        throw std::runtime_error("Tree stream index is damaged");
+    }
+
+    // The block count is bounded by the stream size, so these products
+    // cannot overflow; the key count is not and must be checked against
+    // them rather than rounded up itself. Every key takes at least a byte.
+    std::uint64_t indexBytes = static_cast<std::uint64_t>(trailer - data) - indexOffset;
+    std::uint64_t indexEntries = indexBytes / INDEX_ENTRY_SIZE;
+    if (indexBytes % INDEX_ENTRY_SIZE != 0 || keys > indexEntries * TreeEncoder::BLOCK_KEYS ||
+        (indexEntries > 0 && keys <= (indexEntries - 1) * TreeEncoder::BLOCK_KEYS) ||
+        keys > indexOffset - HEADER_SIZE) {
+        throw std::runtime_error("Tree stream index is damaged");
+    }
+    indexData = data + indexOffset;
+    total = static_cast<size_t>(keys);
+    blocks = static_cast<size_t>(indexEntries);
+}
+
+void TreeDecoder::openBlock(size_t block) {
+    std::uint64_t offset = readFixed(indexData + block * INDEX_ENTRY_SIZE, 8);
+    if (offset < HEADER_SIZE || offset >= static_cast<std::uint64_t>(indexData - data)) {
+        throw std::runtime_error("Tree stream index is damaged");
+    }
+    const std::uint8_t* start = data + offset;
+    std::uint64_t keys = readVarint(start, indexData);
+    std::uint64_t payload = readVarint(start, indexData);
+    size_t expected = std::min(TreeEncoder::BLOCK_KEYS, total - block * TreeEncoder::BLOCK_KEYS);
+    if (keys != expected || payload > static_cast<std::uint64_t>(indexData - start)) {
+        throw std::runtime_error("Tree stream block is damaged");
+    }
+
+    cursor = start;
+    blockEnd = start + payload;
+    blockRemaining = expected;
+    nextBlock = block + 1;
+    previous = 0;
+}
+
+int TreeDecoder::blockFirstKey(size_t block) const {
+    return static_cast<int>(static_cast<std::uint32_t>(readFixed(indexData + block * INDEX_ENTRY_SIZE + 8, 4)));
+}
+
+bool TreeDecoder::next(int& key) {
+    if (blockRemaining == 0) {
+        if (nextBlock >= blocks) {
+            return false;
+        }
+        openBlock(nextBlock);
+    }
+
+    // Differences of two ints need at most 33 bits after zigzag
+    std::uint64_t delta = readVarint(cursor, blockEnd);
+    std::int64_t value = previous + unzigzag(delta);
+    if (delta >> 33 != 0 || value < INT_MIN || value > INT_MAX) {
+        throw std::runtime_error("Tree stream key is out of range");
+    }
+    if (--blockRemaining == 0 && cursor != blockEnd) {
+        throw std::runtime_error("Tree stream block is damaged");
+    }
+    previous = value;
+    key = static_cast<int>(value);
+    return true;
+}
+
+void TreeDecoder::seek(size_t position) {
+    if (position >= total) {
+        blockRemaining = 0;
+        nextBlock = blocks;
+        return;
+    }
+    openBlock(position / TreeEncoder::BLOCK_KEYS);
+    int skipped;
+    for (size_t i = position % TreeEncoder::BLOCK_KEYS; i > 0; --i) {
+        next(skipped);
+    }
+}
+
+bool TreeDecoder::seekLowerBound(int key) {
+    if (keyOrder != TreeFileLayout::Sorted) {
+        throw std::logic_error("seekLowerBound needs a sorted tree stream");
+    }
+
+    // Last block starting at or below `key`; its successor starts above it,
+    // so the answer is in this block or is the next block's first key
+    size_t low = 0;
+    size_t high = blocks;
+    while (low < high) {
+        size_t middle = low + (high - low) / 2;
+        if (blockFirstKey(middle) <= key) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    size_t block = low > 0 ? low - 1 : 0;
+
+    seek(block * TreeEncoder::BLOCK_KEYS);
+    size_t position = block * TreeEncoder::BLOCK_KEYS;
+    int value;
+    while (next(value) && value < key) {
+        ++position;
+    }
+    seek(position);
+    return position < total;
+}
+
+void TreeDecoder::decode(const std::uint8_t* data, size_t size, BinarySearchTree& tree) {
+    TreeDecoder decoder(data, size);
+    std::vector<int> keys;
+    keys.reserve(decoder.size());
+    int key;
+    bool sorted = decoder.order() == TreeFileLayout::Sorted;
+    while (decoder.next(key)) {
+        if (sorted && !keys.empty() && key <= keys.back()) {
+            throw std::runtime_error("Sorted tree stream is out of order");
+        }
+        keys.push_back(key);
+    }
+
+    if (sorted) {
+        tree.buildFromSorted(keys.data(), keys.size());
+    } else {
+        tree.deserialize(keys.data(), keys.size());
+    }
+}
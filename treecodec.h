@@ -0,0 +1,106 @@
+#ifndef TREECODEC_H
+#define TREECODEC_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include "binarysearchtree.h"
+
+// Order of the keys in a saved tree snapshot
+enum class TreeFileLayout : std::uint32_t {
+    Preorder = 0,   // serialize() order, rebuilds the exact shape
+    Sorted = 1      // Strictly increasing, rebuilds a perfectly balanced tree
+};
+
+// Compressed key stream for shipping and archiving tree snapshots.
+//
+//   header   "BSTZ", uint8 version, uint8 key order, 2 reserved bytes
+//   blocks   varint key count (0 ends the blocks), varint payload bytes,
+//            payload: each key as the zigzag varint of its difference to
+//            the previous key, the first key of a block relative to 0
+//   index    per block: uint64 stream offset, int32 first key
+//   trailer  uint64 index offset, uint64 total keys, "BSTZ"
+//
+// Fixed-width fields are little-endian. Sorted keys usually cost one or two
+// bytes each. Blocks hold BLOCK_KEYS keys, all but the last one full, so
+// a reader can jump to any position, or for sorted streams to any key, by
+// decoding a single block.
+class TreeEncoder {
+public:
+    using Sink = std::function<void(const std::uint8_t* data, size_t size)>;
+
+    static constexpr size_t BLOCK_KEYS = 1024;
+
+    // Output goes to `sink` one block at a time, so only the block being
+    // filled and the block index are held in memory
+    TreeEncoder(Sink sink, TreeFileLayout order);
+
+    void push(int key);
+    void finish();   // Writes the last block, the index and the trailer
+
+    // Streams the tree straight from its nodes: sorted for balanced trees,
+    // preorder for unbalanced ones so their shape survives
+    static void encode(const BinarySearchTree& tree, Sink sink);
+
+private:
+    struct IndexEntry {
+        std::uint64_t offset;
+        int firstKey;
+    };
+
+    Sink sink;
+    std::vector<std::uint8_t> payload;
+    size_t blockKeys = 0;
+    int previous = 0;
+    std::uint64_t written = 0;
+    std::uint64_t total = 0;
+    std::vector<IndexEntry> index;
+    bool finished = false;
+
+    void flushBlock();
+    void write(const std::uint8_t* data, size_t size);
+};
+
+// Pull decoder over a complete stream in memory (e.g. a mapped file). It
+// keeps just a cursor into the bytes, never a decoded key array, and throws
+// std::runtime_error on malformed input.
+class TreeDecoder {
+public:
+    TreeDecoder(const std::uint8_t* data, size_t size);
+
+    TreeFileLayout order() const { return keyOrder; }
+    size_t size() const { return total; }
+    size_t blockCount() const { return blocks; }
+
+    bool next(int& key);   // False once every key was read
+
+    // Continue reading from the key at `position`
+    void seek(size_t position);
+
+    // For sorted streams: positions next() at the first key >= `key`.
+    // Returns false, with the stream at its end, if there is none.
+    bool seekLowerBound(int key);
+
+    // Rebuilds `tree` from the stream with the linear-time builders, which
+    // need the keys as one array
+    static void decode(const std::uint8_t* data, size_t size, BinarySearchTree& tree);
+
+private:
+    const std::uint8_t* data;
+    const std::uint8_t* indexData = nullptr;
+    TreeFileLayout keyOrder = TreeFileLayout::Preorder;
+    size_t total = 0;
+    size_t blocks = 0;
+
+    const std::uint8_t* cursor = nullptr;
+    const std::uint8_t* blockEnd = nullptr;
+    size_t blockRemaining = 0;
+    size_t nextBlock = 0;
+    std::int64_t previous = 0;
+
+    void openBlock(size_t block);
+    int blockFirstKey(size_t block) const;
+};
+
+#endif // TREECODEC_H
@@ -0,0 +1,194 @@
+#include "treefile.h"
+#include <QFile>
+#include <QSaveFile>
+#include <QtEndian>
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+static_assert(sizeof(int) == sizeof(std::int32_t), "tree files store keys as int32");
+
+namespace {
+
+const char MAGIC[8] = {'B', 'S', 'T', 'V', 'T', 'R', 'E', 'E'};
+constexpr qint64 HEADER_SIZE = 32;
+
+bool fail(QString* error, const QString& message) {
+    if (error) {
+        *error = message;
+    }
+    return false;
+}
+
+// Verified key array of a mapped .tree file, valid while this object lives
+class MappedKeys {
+public:
+    bool open(const QString& fileName, QString* error);
+
+    TreeFileLayout layout() const { return order; }
+    const std::int32_t* data() const { return keys; }
+    size_t size() const { return count; }
+
+private:
+    QFile file;   // Unmaps on destruction
+    TreeFileLayout order = TreeFileLayout::Preorder;
+    const std::int32_t* keys = nullptr;
+    size_t count = 0;
+#if Q_BYTE_ORDER == Q_BIG_ENDIAN
+    std::vector<std::int32_t> swapped;
+#endif
+};
+
+bool MappedKeys::open(const QString& fileName, QString* error) {
+    file.setFileName(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return fail(error, file.errorString());
+    }
+    qint64 fileSize = file.size();
+    if (fileSize < HEADER_SIZE) {
+        return fail(error, "File is too short to be a tree file");
+    }
+    const uchar* bytes = file.map(0, fileSize);
+    if (!bytes) {
+        return fail(error, file.errorString());
+    }
+    if (std::memcmp(bytes, MAGIC, sizeof(MAGIC)) != 0) {
+        return fail(error, "Not a binary tree file");
+    }
+
+    quint32 version = qFromLittleEndian<quint32>(bytes + 8);
+    if (version != TreeFile::VERSION) {
+        return fail(error, QString("Unsupported tree file version %1").arg(version));
+    }
+    quint32 layoutValue = qFromLittleEndian<quint32>(bytes + 12);
+    if (layoutValue > static_cast<quint32>(TreeFileLayout::Sorted)) {
+        return fail(error, QString("Unknown key order %1").arg(layoutValue));
+    }
+    order = static_cast<TreeFileLayout>(layoutValue);
+
+    quint64 stored = qFromLittleEndian<quint64>(bytes + 16);
+    quint64 payload = static_cast<quint64>(fileSize - HEADER_SIZE);
+    if (payload % sizeof(std::int32_t) != 0 || stored != payload / sizeof(std::int32_t)) {
+        return fail(error, "File size does not match its key count");
+    }
+    count = static_cast<size_t>(stored);
+
+    // The mapping is page aligned and the header a multiple of four bytes,
+    // so the keys can be read in place
+#if Q_BYTE_ORDER == Q_BIG_ENDIAN
+    swapped.resize(count);
+    qFromLittleEndian<qint32>(bytes + HEADER_SIZE, static_cast<qsizetype>(count), swapped.data());
+    keys = swapped.data();
+#else
+    keys = reinterpret_cast<const std::int32_t*>(bytes + HEADER_SIZE);
+#endif
+
+    if (TreeFile::checksum(keys, count) != qFromLittleEndian<quint64>(bytes + 24)) {
+        return fail(error, "Checksum mismatch, the file is damaged");
+    }
+    return true;
+}
+
+} // namespace
+
+bool TreeFile::isBinary(const QString& fileName) {
+    QFile file(fileName);
+    char magic[sizeof(MAGIC)];
+    return file.open(QIODevice::ReadOnly) &&
+           file.read(magic, sizeof(magic)) == static_cast<qint64>(sizeof(magic)) &&
+           std::memcmp(magic, MAGIC, sizeof(MAGIC)) == 0;
+}
+
+bool TreeFile::save(const QString& fileName, const BinarySearchTree& tree, QString* error) {
+    TreeFileLayout layout = tree.getBalancePolicy() == BalancePolicy::None
+                                ? TreeFileLayout::Preorder : TreeFileLayout::Sorted;
+    std::vector<int> keys = layout == TreeFileLayout::Sorted ? tree.inorderTraversal() : tree.serialize();
+
+    uchar header[HEADER_SIZE];
+    std::memcpy(header, MAGIC, sizeof(MAGIC));
+    qToLittleEndian<quint32>(VERSION, header + 8);
+    qToLittleEndian<quint32>(static_cast<quint32>(layout), header + 12);
+    qToLittleEndian<quint64>(keys.size(), header + 16);
+    qToLittleEndian<quint64>(checksum(keys.data(), keys.size()), header + 24);
+#if Q_BYTE_ORDER == Q_BIG_ENDIAN
+    qToLittleEndian<qint32>(keys.data(), static_cast<qsizetype>(keys.size()), keys.data());
+#endif
+
+    // QSaveFile only replaces the old file once everything is written
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return fail(error, file.errorString());
+    }
+    qint64 bytes = static_cast<qint64>(keys.size() * sizeof(int));
+    if (file.write(reinterpret_cast<const char*>(header), HEADER_SIZE) != HEADER_SIZE ||
+        file.write(reinterpret_cast<const char*>(keys.data()), bytes) != bytes) {
+        QString message = file.errorString();
+        file.cancelWriting();
+        return fail(error, message);
+    }
+    if (!file.commit()) {
+        return fail(error, file.errorString());
+    }
+    return true;
+}
+
+bool TreeFile::load(const QString& fileName, BinarySearchTree& tree, QString* error) {
+    MappedKeys keys;
+    if (!keys.open(fileName, error)) {
+        return false;
+    }
+    if (keys.layout() == TreeFileLayout::Preorder) {
+        tree.deserialize(keys.data(), keys.size());
+        return true;
+    }
+    try {
+        tree.buildFromSorted(keys.data(), keys.size());
+    } catch (const std::invalid_argument&) {
+        return fail(error, "Keys of a sorted tree file are out of order");
+    }
+    return true;
+}
+
+bool TreeFile::loadFrozen(const QString& fileName, FrozenTree& frozen, QString* error) {
+    MappedKeys keys;
+    if (!keys.open(fileName, error)) {
+        return false;
+    }
+    if (keys.layout() == TreeFileLayout::Preorder) {
+        // Keep the saved shape so search() reports the original paths
+        BinarySearchTree tree;
+        tree.deserialize(keys.data(), keys.size());
+        frozen = FrozenTree(tree);
+        return true;
+    }
+    try {
+        frozen = FrozenTree::fromSorted(keys.data(), keys.size());
+    } catch (const std::invalid_argument&) {
+        return fail(error, "Keys of a sorted tree file are out of order");
+    }
+    return true;
+}
+
+// Fletcher-64 over the keys as 32-bit words. The sums are only reduced once
+// per block: after 2^15 words the second sum is below 2^61, so it cannot
+// overflow in between.
+std::uint64_t TreeFile::checksum(const std::int32_t* keys, size_t count) {
+    const std::uint64_t MODULUS = 0xFFFFFFFFu;
+    const size_t BLOCK = size_t(1) << 15;
+
+    std::uint64_t low = 0;
+    std::uint64_t high = 0;
+    while (count > 0) {
+        size_t block = std::min(count, BLOCK);
+        for (size_t i = 0; i < block; ++i) {
+            low += static_cast<std::uint32_t>(keys[i]);
+            high += low;
+        }
+        low %= MODULUS;
+        high %= MODULUS;
+        keys += block;
+        count -= block;
+    }
+    return (high << 32) | low;
+}
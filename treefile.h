@@ -0,0 +1,41 @@
+#ifndef TREEFILE_H
+#define TREEFILE_H
+
+#include <QString>
+#include <cstddef>
+#include <cstdint>
+#include "binarysearchtree.h"
+#include "frozentree.h"
+#include "treecodec.h"
+
+// Binary .tree file: a fixed little-endian header followed by the keys as
+// one flat int32 array.
+//
+//   offset  0  char[8]   magic "BSTVTREE"
+//           8  uint32    format version
+//          12  uint32    key order, a TreeFileLayout
+//          16  uint64    key count
+//          24  uint64    Fletcher-64 checksum of the keys
+//          32  int32[]   keys
+//
+// Loading maps the file and hands the key array straight to the linear-time
+// builders, so nothing is parsed or copied on the way in. Files without the
+// magic are the older QSettings INI format.
+class TreeFile {
+public:
+    static constexpr std::uint32_t VERSION = 1;
+
+    static bool isBinary(const QString& fileName);
+
+    // Balanced trees are stored sorted, since only their keys matter;
+    // unbalanced ones in preorder so their shape survives the round trip.
+    static bool save(const QString& fileName, const BinarySearchTree& tree, QString* error = nullptr);
+
+    // Leave the tree or snapshot untouched when they fail
+    static bool load(const QString& fileName, BinarySearchTree& tree, QString* error = nullptr);
+    static bool loadFrozen(const QString& fileName, FrozenTree& frozen, QString* error = nullptr);
+
+    static std::uint64_t checksum(const std::int32_t* keys, size_t count);
+};
+
+#endif // TREEFILE_H
@@ -0,0 +1,406 @@
+// Round-trip and corruption checks for the on-disk formats and the key
+// import parsers.
+//
+//   .tree files  save/load in both key orders, checksum and size mismatches
+//   BSTZ         encode/decode across block boundaries, seeks, truncated
+//                and damaged streams (std::runtime_error and nothing else)
+//   journal      replay, torn tails cut off on reopen, CRC mismatches
+//   key import   text and int32 parsing against a plain reference parser,
+//                at word and chunk boundaries and on malformed text
+//
+// Prints every failed check and exits non-zero if there was one.
+
+#include "keyimport.h"
+#include "treecodec.h"
+#include "treefile.h"
+#include "treejournal.h"
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <filesystem>
+#include <random>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+int failures = 0;
+
+void check(bool condition, const std::string& what) {
+    if (!condition) {
+        std::printf("FAIL: %s\n", what.c_str());
+        ++failures;
+    }
+}
+
+std::string tempPath(const char* name) {
+    std::filesystem::path path = std::filesystem::temp_directory_path() / name;
+    std::filesystem::remove(path);
+    return path.string();
+}
+
+void flipByte(const std::string& path, std::uintmax_t offset) {
+    std::FILE* file = std::fopen(path.c_str(), "r+b");
+    std::fseek(file, static_cast<long>(offset), SEEK_SET);
+    int byte = std::fgetc(file);
+    std::fseek(file, static_cast<long>(offset), SEEK_SET);
+    std::fputc(byte ^ 0x5A, file);
+    std::fclose(file);
+}
+
+std::vector<std::uint8_t> encodeKeys(const std::vector<int>& keys, TreeFileLayout order) {
+    std::vector<std::uint8_t> bytes;
+    TreeEncoder encoder([&](const std::uint8_t* data, size_t size) { bytes.insert(bytes.end(), data, data + size); },
+                        order);
+    for (int key : keys) {
+        encoder.push(key);
+    }
+    encoder.finish();
+    return bytes;
+}
+
+// Reads the whole stream; false when it was rejected with runtime_error
+bool decodesOrRejects(const std::vector<std::uint8_t>& bytes, size_t size, bool& rejected) {
+    rejected = false;
+    try {
+        TreeDecoder decoder(bytes.data(), size);
+        int key;
+        while (decoder.next(key)) {
+        }
+        if (decoder.order() == TreeFileLayout::Sorted) {
+            decoder.seekLowerBound(0);
+        }
+        BinarySearchTree tree(BalancePolicy::AVL);
+        TreeDecoder::decode(bytes.data(), size, tree);
+    } catch (const std::runtime_error&) {
+        rejected = true;
+    } catch (const std::exception&) {
+        return false;
+    }
+    return true;
+}
+
+void checkCodec() {
+    std::mt19937 rng(17);
+    for (size_t count : {0, 1, 2, 1023, 1024, 1025, 5000}) {
+        std::string name = "BSTZ " + std::to_string(count) + " keys: ";
+
+        std::vector<int> preorder(count);
+        for (int& key : preorder) {
+            key = static_cast<int>(rng());
+        }
+        if (count > 2) {
+            preorder[0] = INT_MIN;
+            preorder[1] = INT_MAX;
+        }
+        std::vector<std::uint8_t> bytes = encodeKeys(preorder, TreeFileLayout::Preorder);
+        TreeDecoder decoder(bytes.data(), bytes.size());
+        std::vector<int> decoded;
+        int key;
+        while (decoder.next(key)) {
+            decoded.push_back(key);
+        }
+        check(decoder.order() == TreeFileLayout::Preorder && decoded == preorder, name + "preorder round trip");
+        for (size_t position = 0; position < count; position += 1 + count / 7) {
+            decoder.seek(position);
+            check(decoder.next(key) && key == preorder[position], name + "seek");
+        }
+
+        std::set<int> unique;
+        while (unique.size() < count) {
+            unique.insert(static_cast<int>(rng() % (count * 10 + 1)) - static_cast<int>(count * 5));
+        }
+        std::vector<int> sorted(unique.begin(), unique.end());
+        bytes = encodeKeys(sorted, TreeFileLayout::Sorted);
+        TreeDecoder sortedDecoder(bytes.data(), bytes.size());
+        for (int probe = -static_cast<int>(count * 6); probe <= static_cast<int>(count * 6); probe += 1 + static_cast<int>(count / 50)) {
+            auto expected = std::lower_bound(sorted.begin(), sorted.end(), probe);
+            bool found = sortedDecoder.seekLowerBound(probe);
+            check(found == (expected != sorted.end()) && (!found || (sortedDecoder.next(key) && key == *expected)),
+                  name + "seekLowerBound(" + std::to_string(probe) + ")");
+        }
+
+        // Damage may decode to other keys, but must only ever be rejected
+        // with std::runtime_error
+        bool rejected;
+        for (size_t cut = 0; cut < bytes.size(); cut += 1 + bytes.size() / 64) {
+            check(decodesOrRejects(bytes, cut, rejected) && rejected, name + "truncated at " + std::to_string(cut));
+        }
+        for (int round = 0; round < 64 && !bytes.empty(); ++round) {
+            std::vector<std::uint8_t> damaged = bytes;
+            damaged[rng() % damaged.size()] ^= static_cast<std::uint8_t>(1 + rng() % 255);
+            check(decodesOrRejects(damaged, damaged.size(), rejected), name + "damaged byte");
+        }
+    }
+
+    // A key count near 2^64 used to wrap the block arithmetic
+    std::vector<std::uint8_t> bytes = encodeKeys({1, 2, 3}, TreeFileLayout::Sorted);
+    std::vector<std::uint8_t> huge = bytes;
+    std::fill(huge.end() - 12, huge.end() - 4, 0xFF);
+    bool rejected;
+    check(decodesOrRejects(huge, huge.size(), rejected) && rejected, "BSTZ: huge key count is rejected");
+
+    std::vector<std::uint8_t> unordered = encodeKeys({3, 1, 2}, TreeFileLayout::Preorder);
+    unordered[5] = static_cast<std::uint8_t>(TreeFileLayout::Sorted);
+    check(decodesOrRejects(unordered, unordered.size(), rejected) && rejected,
+          "BSTZ: out-of-order sorted stream is rejected");
+
+    for (BalancePolicy policy : {BalancePolicy::None, BalancePolicy::AVL, BalancePolicy::RedBlack}) {
+        BinarySearchTree tree(policy);
+        for (int i = 0; i < 20000; ++i) {
+            tree.insert(static_cast<int>(rng() % 100000));
+        }
+        std::vector<std::uint8_t> stream;
+        TreeEncoder::encode(tree, [&](const std::uint8_t* data, size_t size) { stream.insert(stream.end(), data, data + size); });
+        BinarySearchTree copy(policy);
+        TreeDecoder::decode(stream.data(), stream.size(), copy);
+        check(copy.serialize() == tree.serialize() || (policy != BalancePolicy::None &&
+                                                        copy.inorderTraversal() == tree.inorderTraversal()),
+              "BSTZ: tree round trip");
+    }
+}
+
+void checkTreeFile() {
+    QString path = QString::fromStdString(tempPath("treeformat_check.tree"));
+    std::mt19937 rng(16);
+
+    for (BalancePolicy policy : {BalancePolicy::None, BalancePolicy::AVL, BalancePolicy::RedBlack}) {
+        BinarySearchTree tree(policy);
+        for (int i = 0; i < 10000; ++i) {
+            tree.insert(static_cast<int>(rng()));
+        }
+        QString error;
+        check(TreeFile::save(path, tree, &error) && TreeFile::isBinary(path), ".tree: save");
+        BinarySearchTree loaded(policy);
+        check(TreeFile::load(path, loaded, &error), ".tree: load");
+        // Unbalanced trees keep their shape, balanced ones their keys
+        if (policy == BalancePolicy::None) {
+            check(loaded.serialize() == tree.serialize(), ".tree: preorder round trip");
+        } else {
+            check(loaded.inorderTraversal() == tree.inorderTraversal() && loaded.validate().balanced,
+                  ".tree: sorted round trip");
+        }
+
+        FrozenTree frozen;
+        check(TreeFile::loadFrozen(path, frozen, &error) && frozen.inorderTraversal() == tree.inorderTraversal(),
+              ".tree: frozen load");
+    }
+
+    BinarySearchTree empty(BalancePolicy::AVL);
+    BinarySearchTree loaded(BalancePolicy::AVL);
+    loaded.insert(1);
+    check(TreeFile::save(path, empty) && TreeFile::load(path, loaded) && loaded.isEmpty(), ".tree: empty tree");
+
+    // Damaged files are refused and leave the tree as it was
+    BinarySearchTree tree(BalancePolicy::AVL);
+    for (int i = 0; i < 1000; ++i) {
+        tree.insert(i * 3);
+    }
+    TreeFile::save(path, tree);
+    std::string file = path.toStdString();
+    flipByte(file, 32 + 4 * 500);   // A key, past the 32-byte header
+    BinarySearchTree kept(BalancePolicy::AVL);
+    kept.insert(7);
+    check(!TreeFile::load(path, kept) && kept.size() == 1 && kept.contains(7), ".tree: checksum mismatch is rejected");
+
+    TreeFile::save(path, tree);
+    std::filesystem::resize_file(file, std::filesystem::file_size(file) - 4);
+    check(!TreeFile::load(path, kept) && kept.size() == 1, ".tree: short file is rejected");
+    std::filesystem::remove(file);
+}
+
+std::vector<int> treeKeys(const std::string& journal) {
+    BinarySearchTree tree(BalancePolicy::AVL);
+    TreeJournal::replay(journal, tree);
+    return tree.inorderTraversal();
+}
+
+std::vector<int> range(int first, int last) {
+    std::vector<int> keys;
+    for (int key = first; key <= last; ++key) {
+        keys.push_back(key);
+    }
+    return keys;
+}
+
+void checkJournal() {
+    std::string path = tempPath("treeformat_check.journal");
+
+    // Each sync() ends a frame
+    std::uintmax_t firstFrameEnd;
+    std::uintmax_t secondFrameEnd;
+    {
+        TreeJournal journal(path);
+        for (int key = 1; key <= 100; ++key) {
+            journal.append(TreeJournal::Op::Insert, key);
+        }
+        journal.sync();
+        firstFrameEnd = std::filesystem::file_size(path);
+        for (int key = 1; key <= 10; ++key) {
+            journal.append(TreeJournal::Op::Remove, key);
+        }
+        journal.sync();
+        secondFrameEnd = std::filesystem::file_size(path);
+        journal.append(TreeJournal::Op::Insert, 500);
+        journal.append(TreeJournal::Op::Insert, -500);
+        check(journal.recordCount() == 112, "journal: record count");
+    }
+    std::vector<int> expected = range(11, 100);
+    expected.insert(expected.begin(), -500);
+    expected.push_back(500);
+    BinarySearchTree tree(BalancePolicy::AVL);
+    check(TreeJournal::replay(path, tree) == 112 && tree.inorderTraversal() == expected, "journal: replay");
+
+    // A torn last frame is ignored on replay and cut off on reopen
+    std::filesystem::resize_file(path, std::filesystem::file_size(path) - 1);
+    check(treeKeys(path) == range(11, 100), "journal: replay stops at a torn frame");
+    {
+        TreeJournal journal(path);
+        check(journal.recordCount() == 110 && std::filesystem::file_size(path) == secondFrameEnd,
+              "journal: reopen cuts off the torn frame");
+        journal.append(TreeJournal::Op::Insert, 7);
+    }
+    expected = range(11, 100);
+    expected.insert(expected.begin(), 7);
+    check(treeKeys(path) == expected, "journal: appends after a repaired tail");
+
+    // A damaged frame ends the journal
+    flipByte(path, firstFrameEnd + 8);
+    check(treeKeys(path) == range(1, 100), "journal: CRC mismatch ends replay");
+
+    std::filesystem::remove(path);
+    {
+        TreeJournal journal(path);
+        journal.append(TreeJournal::Op::Insert, 1);
+        journal.append(TreeJournal::Op::Clear);
+        journal.append(TreeJournal::Op::Insert, 3);
+        journal.sync();
+        check(treeKeys(path) == std::vector<int>{3}, "journal: clear");
+        journal.reset();
+        check(journal.recordCount() == 0 && treeKeys(path).empty(), "journal: reset");
+    }
+
+    std::FILE* file = std::fopen(path.c_str(), "wb");
+    std::fputs("not a journal", file);
+    std::fclose(file);
+    bool rejected = false;
+    try {
+        TreeJournal::replay(path, tree);
+    } catch (const std::runtime_error&) {
+        rejected = true;
+    }
+    check(rejected, "journal: foreign file is rejected");
+    std::filesystem::remove(path);
+}
+
+// The documented text rules, one character at a time
+ImportResult referenceParse(const std::string& text) {
+    ImportResult result;
+    std::set<int> keys;
+    for (size_t i = 0; i < text.size();) {
+        if (text[i] < '0' || text[i] > '9') {
+            ++i;
+            continue;
+        }
+        bool negative = i > 0 && text[i - 1] == '-';
+        long long value = 0;
+        for (; i < text.size() && text[i] >= '0' && text[i] <= '9'; ++i) {
+            value = std::min(value * 10 + (text[i] - '0'), 1LL << 40);
+        }
+        ++result.parsed;
+        value = negative ? -value : value;
+        if (value < INT_MIN || value > INT_MAX) {
+            ++result.outOfRange;
+        } else {
+            keys.insert(static_cast<int>(value));
+        }
+    }
+    result.keys.assign(keys.begin(), keys.end());
+    return result;
+}
+
+void checkText(const std::string& text, const std::string& what) {
+    ImportResult actual = KeyImport::parseText(text.data(), text.size());
+    ImportResult expected = referenceParse(text);
+    check(actual.keys == expected.keys && actual.parsed == expected.parsed && actual.outOfRange == expected.outOfRange,
+          "import: " + what);
+}
+
+void checkKeyImport() {
+    checkText("", "empty");
+    checkText("no keys, only words", "no digits");
+    checkText("1,2,3\n3;2;1", "separators and duplicates");
+    checkText("-1 -0 --5 5-3 - 4 x-9", "minus signs");
+    checkText("2147483647 -2147483648 2147483648 -2147483649", "int limits");
+    checkText("000000000000000000042 99999999999999999999999 -99999999999", "long digit runs");
+    checkText(std::string("1\0" "2\xff" "3\x80" "4", 7), "control and high bytes");
+
+    // Every number length at every offset of the eight-byte words
+    for (int offset = 0; offset < 17; ++offset) {
+        for (int length = 1; length <= 12; ++length) {
+            std::string text(offset, ' ');
+            text += offset % 2 ? "-" : "";
+            for (int digit = 0; digit < length; ++digit) {
+                text += static_cast<char>('1' + digit % 9);
+            }
+            checkText(text, "word offset " + std::to_string(offset) + " length " + std::to_string(length));
+            checkText(text + ",5", "word offset " + std::to_string(offset) + " length " + std::to_string(length) + " then more");
+        }
+    }
+
+    // Several megabytes split into chunks: consecutive negative numbers put
+    // every cut inside a number or right after its minus sign
+    std::string text;
+    for (int key = 0; text.size() < (size_t(6) << 20); ++key) {
+        text += "-" + std::to_string(key) + ",";
+    }
+    checkText(text, "chunk boundaries");
+
+    std::mt19937 rng(19);
+    const char separators[] = " ,;\n\t-x";
+    text.clear();
+    while (text.size() < (size_t(5) << 20)) {
+        text += separators[rng() % (sizeof(separators) - 1)];
+        if (rng() % 3) {
+            text += std::to_string(rng() % (rng() % 2 ? 1000u : 0xFFFFFFFFu));
+        }
+    }
+    checkText(text, "random text");
+
+    std::vector<int> keys(size_t(3) << 20);
+    std::string bytes;
+    for (int& key : keys) {
+        key = static_cast<int>(rng());
+        for (int shift = 0; shift < 32; shift += 8) {
+            bytes += static_cast<char>(static_cast<std::uint32_t>(key) >> shift);
+        }
+    }
+    ImportResult binary = KeyImport::parseBinary(bytes.data(), bytes.size());
+    std::set<int> unique(keys.begin(), keys.end());
+    check(binary.parsed == keys.size() && binary.keys == std::vector<int>(unique.begin(), unique.end()),
+          "import: int32 keys");
+
+    bool rejected = false;
+    try {
+        KeyImport::parseBinary(bytes.data(), 7);
+    } catch (const std::invalid_argument&) {
+        rejected = true;
+    }
+    check(rejected, "import: partial int32 is rejected");
+}
+
+} // namespace
+
+int main() {
+    checkCodec();
+    checkTreeFile();
+    checkJournal();
+    checkKeyImport();
+    std::printf(failures ? "%d checks failed\n" : "all checks passed\n", failures);
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,357 @@
+#include "treejournal.h"
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace {
+
+const char MAGIC[4] = {'B', 'S', 'T', 'J'};
+constexpr std::uint8_t VERSION = 1;
+constexpr size_t HEADER_SIZE = 8;
+constexpr size_t FRAME_HEADER_SIZE = 8;
+
+std::uint32_t crc32(const std::uint8_t* data, size_t size) {
+    static const std::vector<std::uint32_t> table = [] {
+        std::vector<std::uint32_t> entries(256);
+        for (std::uint32_t i = 0; i < 256; ++i) {
+            std::uint32_t value = i;
+            for (int bit = 0; bit < 8; ++bit) {
+                value = (value >> 1) ^ (value & 1 ? 0xEDB88320u : 0);
+            }
+            entries[i] = value;
+        }
+        return entries;
+    }();
+
+    std::uint32_t crc = 0xFFFFFFFFu;
+    for (size_t i = 0; i < size; ++i) {
+        crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return crc ^ 0xFFFFFFFFu;
+}
+
+std::uint32_t readUint32(const std::uint8_t* data) {
+    return static_cast<std::uint32_t>(data[0]) | static_cast<std::uint32_t>(data[1]) << 8 |
+           static_cast<std::uint32_t>(data[2]) << 16 | static_cast<std::uint32_t>(data[3]) << 24;
+}
+
+void writeUint32(std::uint8_t* data, std::uint32_t value) {
+    for (int i = 0; i < 4; ++i) {
+        data[i] = static_cast<std::uint8_t>(value >> (8 * i));
+    }
+}
+
+// Flushes the stdio buffer and then the operating system's cache
+bool syncFile(std::FILE* file) {
+    if (std::fflush(file) != 0) {
+        return false;
+    }
+#ifdef _WIN32
+    return _commit(_fileno(file)) == 0;
+#else
+    return fsync(fileno(file)) == 0;
+#endif
+}
+
+bool truncateFile(std::FILE* file, size_t size) {
+    if (std::fflush(file) != 0) {
+        return false;
+    }
+#ifdef _WIN32
+    return _chsize_s(_fileno(file), static_cast<long long>(size)) == 0;
+#else
+    return ftruncate(fileno(file), static_cast<off_t>(size)) == 0;
+#endif
+}
+
+bool readFile(const std::string& path, std::vector<std::uint8_t>& bytes) {
+    std::FILE* file = std::fopen(path.c_str(), "rb");
+    if (!file) {
+        return false;
+    }
+    std::uint8_t buffer[1 << 16];
+    size_t read;
+    while ((read = std::fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        bytes.insert(bytes.end(), buffer, buffer + read);
+    }
+    bool ok = !std::ferror(file);
+    std::fclose(file);
+    return ok;
+}
+
+bool hasHeader(const std::vector<std::uint8_t>& bytes) {
+    return bytes.size() >= HEADER_SIZE && std::memcmp(bytes.data(), MAGIC, sizeof(MAGIC)) == 0 &&
+           bytes[4] == VERSION;
+}
+
+std::uint64_t encodeRecord(TreeJournal::Op op, int key) {
+    std::uint64_t zigzag = (static_cast<std::uint64_t>(static_cast<std::int64_t>(key)) << 1) ^
+                           static_cast<std::uint64_t>(static_cast<std::int64_t>(key) >> 63);
+    return zigzag << 2 | static_cast<std::uint64_t>(op);
+}
+
+// Parses one frame's payload, all or nothing
+bool decodePayload(const std::uint8_t* data, size_t size,
+                   std::vector<std::pair<TreeJournal::Op, int>>& records) {
+    records.clear();
+    const std::uint8_t* end = data + size;
+    while (data != end) {
+        std::uint64_t value = 0;
+        int shift = 0;
+        std::uint8_t byte;
+        do {
+            if (data == end || shift > 35) {
+                return false;
+            }
+            byte = *data++;
+            value |= static_cast<std::uint64_t>(byte & 0x7F) << shift;
+            shift += 7;
+        } while (byte & 0x80);
+
+        std::uint64_t zigzag = value >> 2;
+        std::int64_t key = static_cast<std::int64_t>(zigzag >> 1) ^ -static_cast<std::int64_t>(zigzag & 1);
+        if ((value & 3) == 3 || key < INT_MIN || key > INT_MAX) {
+            return false;
+        }
+        records.emplace_back(static_cast<TreeJournal::Op>(value & 3), static_cast<int>(key));
+    }
+    return true;
+}
+
+// Calls visit(op, key) for every record of the intact frames and returns the
+// offset just past the last of them
+template <typename Visit>
+size_t scanFrames(const std::vector<std::uint8_t>& bytes, Visit visit) {
+    std::vector<std::pair<TreeJournal::Op, int>> records;
+    size_t offset = HEADER_SIZE;
+    while (bytes.size() - offset >= FRAME_HEADER_SIZE) {
+        const std::uint8_t* frame = bytes.data() + offset;
+        size_t size = readUint32(frame);
+        if (size > bytes.size() - offset - FRAME_HEADER_SIZE ||
+            crc32(frame + FRAME_HEADER_SIZE, size) != readUint32(frame + 4) ||
+            !decodePayload(frame + FRAME_HEADER_SIZE, size, records)) {
+            break;
+        }
+        for (const auto& record : records) {
+            visit(record.first, record.second);
+        }
+        offset += FRAME_HEADER_SIZE + size;
+    }
+    return offset;
+}
+
+} // namespace
+
+TreeJournal::TreeJournal(const std::string& path)
+    : TreeJournal(path, Options())
+{
+}
+
+TreeJournal::TreeJournal(const std::string& path, Options options)
+    : options(options)
+{
+    std::vector<std::uint8_t> bytes;
+    if (readFile(path, bytes) && !bytes.empty()) {
+        if (!hasHeader(bytes)) {
+            throw std::runtime_error(path + " is not a tree journal");
+        }
+        size_t end = scanFrames(bytes, [this](Op, int) { ++records; });
+        file = std::fopen(path.c_str(), "r+b");
+        if (!file) {
+            throw std::runtime_error("Cannot open journal " + path);
+        }
+        if (end < bytes.size() && (!truncateFile(file, end) || !syncFile(file))) {
+            std::fclose(file);
+            throw std::runtime_error("Cannot repair journal " + path);
+        }
+        std::fseek(file, 0, SEEK_END);
+    } else {
+        file = std::fopen(path.c_str(), "w+b");
+        if (!file) {
+            throw std::runtime_error("Cannot create journal " + path);
+        }
+        std::uint8_t header[HEADER_SIZE] = {};
+        std::memcpy(header, MAGIC, sizeof(MAGIC));
+        header[4] = VERSION;
+        if (std::fwrite(header, 1, sizeof(header), file) != sizeof(header) || !syncFile(file)) {
+            std::fclose(file);
+            throw std::runtime_error("Cannot write journal " + path);
+        }
+    }
+    flusher = std::thread(&TreeJournal::flushLoop, this);
+}
+
+TreeJournal::~TreeJournal() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wakeFlusher.notify_one();
+    flusher.join();
+    std::fclose(file);
+}
+
+void TreeJournal::append(Op op, int key) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!failure.empty()) {
+        throw std::runtime_error(failure);
+    }
+
+    std::uint64_t value = encodeRecord(op, op == Op::Clear ? 0 : key);
+    while (value >= 0x80) {
+        pending.push_back(static_cast<std::uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    pending.push_back(static_cast<std::uint8_t>(value));
+    ++appended;
+    ++records;
+
+    // The first pending record starts the flusher's delay timer
+    if (++pendingRecords == 1) {
+        oldestPending = std::chrono::steady_clock::now();
+        wakeFlusher.notify_one();
+    } else if (pendingRecords >= options.batchRecords) {
+        wakeFlusher.notify_one();
+    }
+}
+
+void TreeJournal::sync() {
+    std::unique_lock<std::mutex> lock(mutex);
+    std::uint64_t target = appended;
+    if (durable < target) {
+        syncRequested = true;
+        wakeFlusher.notify_one();
+        flushed.wait(lock, [this, target] { return durable >= target; });
+    }
+    if (!failure.empty()) {
+        throw std::runtime_error(failure);
+    }
+}
+
+void TreeJournal::reset() {
+    std::lock_guard<std::mutex> lock(mutex);
+    pending.clear();
+    pendingRecords = 0;
+    records = 0;
+
+    // Waits for a group that is being written, then cuts it off with the rest
+    std::lock_guard<std::mutex> fileLock(fileMutex);
+    if (!truncateFile(file, HEADER_SIZE) || std::fseek(file, 0, SEEK_END) != 0 || !syncFile(file)) {
+        failure = "Cannot reset the journal";
+    }
+    durable = appended;
+    flushed.notify_all();
+    if (!failure.empty()) {
+        throw std::runtime_error(failure);
+    }
+}
+
+size_t TreeJournal::recordCount() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return records;
+}
+
+void TreeJournal::flushLoop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        bool due = stopping || syncRequested || pendingRecords >= options.batchRecords ||
+                   (pendingRecords > 0 && std::chrono::steady_clock::now() >= oldestPending + options.batchDelay);
+        if (!due) {
+            if (pendingRecords == 0) {
+                wakeFlusher.wait(lock);
+            } else {
+                wakeFlusher.wait_until(lock, oldestPending + options.batchDelay);
+            }
+            continue;
+        }
+        syncRequested = false;
+        if (pendingRecords == 0) {
+            if (stopping) {
+                return;
+            }
+            continue;
+        }
+
+        // Group commit: everything pending goes out as one frame and one sync,
+        // while append() keeps filling a fresh buffer
+        std::vector<std::uint8_t> payload;
+        payload.swap(pending);
+        pendingRecords = 0;
+        std::uint64_t target = appended;
+
+        std::unique_lock<std::mutex> fileLock(fileMutex);
+        lock.unlock();
+        std::string error = writeFrame(payload);
+        fileLock.unlock();
+        lock.lock();
+
+        if (!error.empty() && failure.empty()) {
+            failure = error;
+        }
+        durable = std::max(durable, target);
+        flushed.notify_all();
+    }
+}
+
+std::string TreeJournal::writeFrame(const std::vector<std::uint8_t>& payload) {
+    std::uint8_t header[FRAME_HEADER_SIZE];
+    writeUint32(header, static_cast<std::uint32_t>(payload.size()));
+    writeUint32(header + 4, crc32(payload.data(), payload.size()));
+    if (std::fwrite(header, 1, sizeof(header), file) != sizeof(header) ||
+        std::fwrite(payload.data(), 1, payload.size(), file) != payload.size()) {
+        return "Cannot write to the journal";
+    }
+    if (!syncFile(file)) {
+        return "Cannot sync the journal";
+    }
+    return std::string();
+}
+
+size_t TreeJournal::replay(const std::string& path, BinarySearchTree& tree) {
+    std::vector<std::uint8_t> bytes;
+    if (!readFile(path, bytes) || bytes.empty()) {
+        return 0;
+    }
+    if (!hasHeader(bytes)) {
+        throw std::runtime_error(path + " is not a tree journal");
+    }
+
+    size_t applied = 0;
+    Op runOp = Op::Insert;
+    std::vector<int> run;
+    auto applyRun = [&] {
+        if (run.empty()) {
+            return;
+        }
+        if (runOp == Op::Insert) {
+            tree.insertBatch(run);
+        } else {
+            tree.removeBatch(run);
+        }
+        run.clear();
+    };
+
+    scanFrames(bytes, [&](Op op, int key) {
+        ++applied;
+        if (op == Op::Clear) {
+            run.clear();
+            tree.clear();
+            return;
+        }
+        if (op != runOp) {
+            applyRun();
+            runOp = op;
+        }
+        run.push_back(key);
+    });
+    applyRun();
+    return applied;
+}
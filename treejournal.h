@@ -0,0 +1,88 @@
+#ifndef TREEJOURNAL_H
+#define TREEJOURNAL_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "binarysearchtree.h"
+
+// Write-ahead log of the mutations made since the last snapshot of a tree.
+//
+//   header  "BSTJ", uint8 version, 3 reserved bytes
+//   frames  uint32 payload bytes, uint32 CRC-32 of the payload, payload
+//
+// A payload holds one or more records, each a single varint of
+// (zigzag(key) << 2) | op, so most records take one to three bytes.
+//
+// append() only buffers the record. A flusher thread writes everything
+// pending as one frame and syncs the file once for the whole group: when
+// `batchRecords` are pending, when the oldest has waited `batchDelay`, or
+// when sync() asks for it. A crash can lose the last unsynced group. It
+// never leaves a partial group: a torn or damaged frame ends the journal.
+//
+// Every record sets a key's membership outright, so replaying is
+// idempotent. After a checkpoint the caller writes a new snapshot and then
+// calls reset(). If it crashes between the two, the next replay only
+// repeats records the snapshot already contains.
+class TreeJournal {
+public:
+    enum class Op : std::uint8_t { Insert = 0, Remove = 1, Clear = 2 };
+
+    struct Options {
+        size_t batchRecords = 512;
+        std::chrono::milliseconds batchDelay{20};
+    };
+
+    // Opens or creates the journal for appending and cuts off a torn tail
+    // left by a crash. Throws std::runtime_error if it can't.
+    explicit TreeJournal(const std::string& path);
+    TreeJournal(const std::string& path, Options options);
+    ~TreeJournal();   // Writes and syncs what is still pending
+    TreeJournal(const TreeJournal&) = delete;
+    TreeJournal& operator=(const TreeJournal&) = delete;
+
+    // Both throw std::runtime_error once a write or sync has failed
+    void append(Op op, int key = 0);
+    void sync();   // Returns once every appended record is on disk
+
+    // Empties the journal once a snapshot holds all of its records
+    void reset();
+
+    // Records in the journal since the last reset, durable or not
+    size_t recordCount() const;
+
+    // Applies the journal's intact records to `tree`, batching runs of
+    // inserts or removes, and returns how many were applied. A missing
+    // journal applies nothing.
+    static size_t replay(const std::string& path, BinarySearchTree& tree);
+
+private:
+    std::FILE* file = nullptr;
+    Options options;
+
+    mutable std::mutex mutex;
+    std::condition_variable wakeFlusher;
+    std::condition_variable flushed;
+    std::vector<std::uint8_t> pending;
+    size_t pendingRecords = 0;
+    std::chrono::steady_clock::time_point oldestPending;
+    std::uint64_t appended = 0;   // Sequence number of the last record appended
+    std::uint64_t durable = 0;    // ...and of the last one synced
+    size_t records = 0;
+    bool syncRequested = false;
+    bool stopping = false;
+    std::string failure;
+
+    std::mutex fileMutex;   // Orders frame writes against reset()
+    std::thread flusher;
+
+    void flushLoop();
+    std::string writeFrame(const std::vector<std::uint8_t>& payload);
+};
+
+#endif // TREEJOURNAL_H
@@ -0,0 +1,197 @@
+#include "treelayout.h"
+#include <algorithm>
+
+namespace {
+
+constexpr double MIN_SEPARATION = 1.0;
+
+// Working state of one node while its subtree is being placed
+struct Shape {
+    int left = -1;
+    int right = -1;
+    double offset = 0;        // x relative to the parent
+    int thread = -1;          // Next contour node below a leaf, if any
+    double threadOffset = 0;  // ...and its x relative to this node
+
+    // Leftmost and rightmost nodes on the deepest level of the subtree,
+    // with x relative to the subtree root
+    int leftExtreme = -1;
+    int rightExtreme = -1;
+    double leftExtremeX = 0;
+    double rightExtremeX = 0;
+};
+
+// Next node down the left or right contour, with its x relative to `node`
+int nextOnContour(const std::vector<Shape>& shapes, int node, bool leftSide, double& x) {
+    const Shape& shape = shapes[node];
+    int child = leftSide ? (shape.left >= 0 ? shape.left : shape.right)
+                         : (shape.right >= 0 ? shape.right : shape.left);
+    if (child >= 0) {
+        x += shapes[child].offset;
+        return child;
+    }
+    x += shape.threadOffset;
+    return shape.thread;
+}
+
+// Places the children of `node` relative to it, given both are placed
+void placeChildren(std::vector<Shape>& shapes, int node) {
+    Shape& shape = shapes[node];
+    if (shape.left < 0 && shape.right < 0) {
+        shape.leftExtreme = shape.rightExtreme = node;
+        return;
+    }
+    if (shape.left < 0 || shape.right < 0) {
+        int child = shape.left >= 0 ? shape.left : shape.right;
+        double offset = shape.left >= 0 ? -MIN_SEPARATION / 2 : MIN_SEPARATION / 2;
+        shapes[child].offset = offset;
+        shape.leftExtreme = shapes[child].leftExtreme;
+        shape.rightExtreme = shapes[child].rightExtreme;
+        shape.leftExtremeX = shapes[child].leftExtremeX + offset;
+        shape.rightExtremeX = shapes[child].rightExtremeX + offset;
+        return;
+    }
+
+    // Walk down the right contour of the left subtree and the left contour
+    // of the right one, widening the gap between their roots wherever the
+    // two come too close
+    int inner = shape.left;
+    int outer = shape.right;
+    double innerX = 0;   // Relative to the left child
+    double outerX = 0;   // Relative to the right child
+    double separation = MIN_SEPARATION;
+    int nextInner;
+    int nextOuter;
+    while (true) {
+        separation = std::max(separation, innerX - outerX + MIN_SEPARATION);
+        double nextInnerX = innerX;
+        double nextOuterX = outerX;
+        nextInner = nextOnContour(shapes, inner, false, nextInnerX);
+        nextOuter = nextOnContour(shapes, outer, true, nextOuterX);
+        if (nextInner < 0 || nextOuter < 0) {
+            innerX = nextInnerX;
+            outerX = nextOuterX;
+            break;
+        }
+        inner = nextInner;
+        outer = nextOuter;
+        innerX = nextInnerX;
+        outerX = nextOuterX;
+    }
+
+    Shape& left = shapes[shape.left];
+    Shape& right = shapes[shape.right];
+    left.offset = -separation / 2;
+    right.offset = separation / 2;
+
+    // The shallower subtree's outer contour continues into the deeper one:
+    // thread its deepest extreme to the next contour node on that side
+    if (nextInner < 0 && nextOuter >= 0) {
+        Shape& extreme = shapes[left.leftExtreme];
+        extreme.thread = nextOuter;
+        extreme.threadOffset = (right.offset + outerX) - (left.offset + left.leftExtremeX);
+        shape.leftExtreme = right.leftExtreme;
+        shape.leftExtremeX = right.leftExtremeX + right.offset;
+        shape.rightExtreme = right.rightExtreme;
+        shape.rightExtremeX = right.rightExtremeX + right.offset;
+    } else if (nextOuter < 0 && nextInner >= 0) {
+        Shape& extreme = shapes[right.rightExtreme];
+        extreme.thread = nextInner;
+        extreme.threadOffset = (left.offset + innerX) - (right.offset + right.rightExtremeX);
+        shape.leftExtreme = left.leftExtreme;
+        shape.leftExtremeX = left.leftExtremeX + left.offset;
+        shape.rightExtreme = left.rightExtreme;
+        shape.rightExtremeX = left.rightExtremeX + left.offset;
+    } else {
+        shape.leftExtreme = left.leftExtreme;
+        shape.leftExtremeX = left.leftExtremeX + left.offset;
+        shape.rightExtreme = right.rightExtreme;
+        shape.rightExtremeX = right.rightExtremeX + right.offset;
+    }
+}
+
+} // namespace
+
+std::vector<LayoutNode> TreeLayout::compute(const std::vector<int>& preorder) {
+    size_t count = preorder.size();
+    std::vector<LayoutNode> nodes(count);
+    std::vector<Shape> shapes(count);
+    if (count == 0) {
+        return nodes;
+    }
+
+    // Recover the shape from the preorder keys. The stack holds the path of
+    // nodes still open for a right child; a key larger than its top belongs
+    // to the right of the last one it climbs past.
+    std::vector<int> open;
+    nodes[0] = {preorder[0], -1, 0, 0};
+    open.push_back(0);
+    for (size_t i = 1; i < count; ++i) {
+        int index = static_cast<int>(i);
+        int parent = -1;
+        while (!open.empty() && preorder[open.back()] < preorder[i]) {
+            parent = open.back();
+            open.pop_back();
+        }
+        if (parent >= 0) {
+            shapes[parent].right = index;
+        } else {
+            parent = open.back();
+            shapes[parent].left = index;
+        }
+        nodes[i] = {preorder[i], parent, 0, nodes[parent].depth + 1};
+        open.push_back(index);
+    }
+
+    // Children follow their parent in preorder, so walking the array
+    // backwards places every subtree before its root
+    for (size_t i = count; i-- > 0;) {
+        placeChildren(shapes, static_cast<int>(i));
+    }
+
+    double leftmost = 0;
+    for (size_t i = 1; i < count; ++i) {
+        nodes[i].x = nodes[nodes[i].parent].x + shapes[i].offset;
+        leftmost = std::min(leftmost, nodes[i].x);
+    }
+    for (LayoutNode& node : nodes) {
+        node.x -= leftmost;
+    }
+    return nodes;
+}
+
+double TreeLayout::width(const std::vector<LayoutNode>& nodes) {
+    double widest = 0;
+    for (const LayoutNode& node : nodes) {
+        widest = std::max(widest, node.x);
+    }
+    return widest;
+}
+
+int TreeLayout::height(const std::vector<LayoutNode>& nodes) {
+    int deepest = 0;
+    for (const LayoutNode& node : nodes) {
+        deepest = std::max(deepest, node.depth);
+    }
+    return deepest;
+}
+
+// A node's inorder turn comes once a larger key shows up in the preorder,
+// which is when the shape recovery in compute() would climb past it
+std::vector<int> TreeLayout::keyOrder(const std::vector<LayoutNode>& nodes) {
+    std::vector<int> order;
+    order.reserve(nodes.size());
+    std::vector<int> open;
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        while (!open.empty() && nodes[open.back()].key < nodes[i].key) {
+            order.push_back(open.back());
+            open.pop_back();
+        }
+        open.push_back(static_cast<int>(i));
+    }
+    while (!open.empty()) {
+        order.push_back(open.back());
+        open.pop_back();
+    }
+    return order;
+}
@@ -0,0 +1,37 @@
+#ifndef TREELAYOUT_H
+#define TREELAYOUT_H
+
+#include <cstddef>
+#include <vector>
+
+// Tidy drawing of a binary search tree after Reingold and Tilford: every
+// subtree is laid out once, bottom-up, and pushed just far enough from its
+// sibling that no two nodes on any level come closer than one unit. The
+// contours compared at each node are followed through threads left on the
+// leaves, so the whole layout takes linear time. Left children always sit
+// left of their parent and right children right of it.
+//
+// Works on a preorder key snapshot (BinarySearchTree::serialize()) rather
+// than on the live tree, so it can run on a worker thread while the tree
+// keeps changing.
+struct LayoutNode {
+    int key;
+    int parent;    // Index of the parent in the layout, -1 for the root
+    double x;      // In units of the minimum node spacing, leftmost node at 0
+    int depth;
+};
+
+class TreeLayout {
+public:
+    // One node per key, in the snapshot's preorder
+    static std::vector<LayoutNode> compute(const std::vector<int>& preorder);
+
+    // Largest x and depth in a layout, 0 for an empty one
+    static double width(const std::vector<LayoutNode>& nodes);
+    static int height(const std::vector<LayoutNode>& nodes);
+
+    // Indices of a layout's nodes in increasing key order, in linear time
+    static std::vector<int> keyOrder(const std::vector<LayoutNode>& nodes);
+};
+
+#endif // TREELAYOUT_H
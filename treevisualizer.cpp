@@ -3,10 +3,14 @@
 #include <QPen>
 #include <QBrush>
 #include <QVariantAnimation>
+#include <QtConcurrent/QtConcurrentRun>
+#include <algorithm>
 
 TreeVisualizer::TreeVisualizer(QWidget *parent)
     : QGraphicsView(parent)
     , scene(new QGraphicsScene(this))
+    , layoutWatcher(new QFutureWatcher<std::vector<LayoutNode>>(this))
+    , resizeTimer(new QTimer(this))
     , defaultNodeColor(QColor(100, 181, 246))  // Material Blue 300
     , highlightColor(QColor(76, 175, 80))      // Material Green 500
 {
@@ -16,6 +20,22 @@ TreeVisualizer::TreeVisualizer(QWidget *parent)
     setHorizontalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
     setVerticalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
     setBackgroundBrush(QBrush(Qt::white));
+    setDragMode(QGraphicsView::ScrollHandDrag);  // Pan large trees by dragging
+    
+    // The layout does not depend on the view size: the view centres trees
+    // narrower than itself, and resizing keeps the middle of wider ones in
+    // place. Once the size settles the tree is fitted to the view again by
+    // its transform alone, so a resize never lays out or redraws the scene.
+    setAlignment(Qt::AlignHCenter | Qt::AlignTop);
+    setResizeAnchor(QGraphicsView::AnchorViewCenter);
+    resizeTimer->setSingleShot(true);
+    resizeTimer->setInterval(RESIZE_SETTLE_MS);
+    connect(resizeTimer, &QTimer::timeout, this, [this]() {
+        // Keep whatever the user zoomed in or out on top of the fit
+        applyFit(transform().m11() / fitScale);
+    });
+    
+    connect(layoutWatcher, &QFutureWatcher<std::vector<LayoutNode>>::finished, this, &TreeVisualizer::applyLayout);
 }
 
 TreeVisualizer::~TreeVisualizer() {
@@ -23,13 +43,19 @@ TreeVisualizer::~TreeVisualizer() {
 }
 
 void TreeVisualizer::clearScene() {
+    removeNodeItems();
+    delete batchedItem;
+    batchedItem = nullptr;
+    highlighted.clear();
+    scene->clear();
+    scene->setSceneRect(QRectF());
+}
+
+void TreeVisualizer::removeNodeItems() {
     for (auto& [value, graphics] : nodeItems) {
-        delete graphics.circle;
-        delete graphics.text;
-        delete graphics.parentLine;
+        removeNode(graphics);
     }
     nodeItems.clear();
-    scene->clear();
 }
 
 void TreeVisualizer::setBST(const std::shared_ptr<BinarySearchTree>& newBST) {
@@ -38,89 +64,199 @@ void TreeVisualizer::setBST(const std::shared_ptr<BinarySearchTree>& newBST) {
 }
 
 void TreeVisualizer::updateTree() {
-    clearScene();
-    if (!bst || !bst->getRoot()) {
+    clearHighlights();
+    if (layoutWatcher->isRunning()) {
+        // Changes made meanwhile coalesce into one more layout once it lands
+        layoutPending = true;
         return;
     }
-    drawTree();
+    startLayout();
 }
 
-void TreeVisualizer::drawTree() {
-    std::map<int, NodeGraphics> newItems;
-    double sceneWidth = width() - 2 * NODE_RADIUS;
-    calculateNodePositions(bst->getRoot(), sceneWidth / 2, NODE_RADIUS + 10, sceneWidth / 4, newItems);
-    
-    for (auto& [value, graphics] : newItems) {
-        if (!graphics.circle) {
-            graphics.circle = new QGraphicsEllipseItem(-NODE_RADIUS, -NODE_RADIUS, 
-                                                     2 * NODE_RADIUS, 2 * NODE_RADIUS);
-            graphics.circle->setBrush(QBrush(defaultNodeColor));
-            graphics.circle->setPen(QPen(Qt::black));
-            scene->addItem(graphics.circle);
-        }
-        
-        if (!graphics.text) {
-            graphics.text = new QGraphicsTextItem(QString::number(value));
-            graphics.text->setDefaultTextColor(Qt::black);
-            scene->addItem(graphics.text);
-        }
-        
-        graphics.circle->setPos(graphics.targetPos);
-        graphics.text->setPos(graphics.targetPos.x() - 10, graphics.targetPos.y() - 10);
+void TreeVisualizer::startLayout() {
+    layoutPending = false;
+    if (!bst || !bst->getRoot()) {
+        clearScene();
+        return;
     }
     
-    nodeItems = std::move(newItems);
+    // The worker lays out a copy of the keys, so the tree may change meanwhile
+    std::vector<int> snapshot = bst->serialize();
+    layoutWatcher->setFuture(QtConcurrent::run([snapshot = std::move(snapshot)]() {
+        return TreeLayout::compute(snapshot);
+    }));
 }
 
-void TreeVisualizer::calculateNodePositions(const std::shared_ptr<BSTNode>& node, double x, double y,
-                                          double offset, std::map<int, NodeGraphics>& newItems) {
-    if (!node) return;
+void TreeVisualizer::applyLayout() {
+    if (layoutPending) {
+        startLayout();
+        return;
+    }
+    drawTree(layoutWatcher->future().takeResult());
+}
 
-    NodeGraphics& graphics = newItems[node->value];
-    graphics.targetPos = QPointF(x, y);
+void TreeVisualizer::drawTree(const std::vector<LayoutNode>& layout) {
+    double treeWidth = TreeLayout::width(layout) * NODE_SPACING;
+    double left = NODE_RADIUS + 10;
+    double top = NODE_RADIUS + 10;
+    
+    std::vector<QPointF> positions(layout.size());
+    for (size_t i = 0; i < layout.size(); ++i) {
+        const LayoutNode& node = layout[i];
+        positions[i] = QPointF(left + node.x * NODE_SPACING, top + node.depth * LEVEL_HEIGHT);
+    }
+    
+    scene->setSceneRect(0, 0, left + treeWidth + left, top + TreeLayout::height(layout) * LEVEL_HEIGHT + top);
+    
+    if (layout.size() > BATCHED_RENDER_NODES) {
+        drawBatched(layout, std::move(positions));
+    } else {
+        drawItems(layout, positions);
+    }
+    applyHighlights();
+}
 
-    if (node->left) {
-        calculateNodePositions(node->left, x - offset, y + LEVEL_HEIGHT, offset / 2, newItems);
-        QPointF startPos(x, y);
-        QPointF endPos = newItems[node->left->value].targetPos;
-        auto* line = new QGraphicsLineItem(QLineF(startPos, endPos));
-        scene->addItem(line);
-        graphics.parentLine = line;
+void TreeVisualizer::drawBatched(const std::vector<LayoutNode>& layout, std::vector<QPointF> positions) {
+    removeNodeItems();
+    if (!batchedItem) {
+        batchedItem = new BatchedTreeItem(NODE_RADIUS, defaultNodeColor);
+        scene->addItem(batchedItem);
     }
+    batchedItem->setNodes(layout, std::move(positions));
+}
 
-    if (node->right) {
-        calculateNodePositions(node->right, x + offset, y + LEVEL_HEIGHT, offset / 2, newItems);
-        QPointF startPos(x, y);
-        QPointF endPos = newItems[node->right->value].targetPos;
-        auto* line = new QGraphicsLineItem(QLineF(startPos, endPos));
-        scene->addItem(line);
-        if (!graphics.parentLine) {
-            graphics.parentLine = line;
+// Diffs the new layout against the items already in the scene: only nodes
+// that appeared, disappeared or moved touch their graphics items
+void TreeVisualizer::drawItems(const std::vector<LayoutNode>& layout, const std::vector<QPointF>& positions) {
+    delete batchedItem;
+    batchedItem = nullptr;
+    
+    ++generation;
+    for (size_t i = 0; i < layout.size(); ++i) {
+        const LayoutNode& node = layout[i];
+        placeNode(node.key, positions[i], node.parent >= 0 ? &positions[node.parent] : nullptr);
+    }
+    
+    // Whatever the walk did not reach has left the tree
+    for (auto it = nodeItems.begin(); it != nodeItems.end();) {
+        if (it->second.generation != generation) {
+            removeNode(it->second);
+            it = nodeItems.erase(it);
+        } else {
+            ++it;
         }
     }
 }
 
+void TreeVisualizer::placeNode(int value, const QPointF& pos, const QPointF* parentPos) {
+    NodeGraphics& graphics = nodeItems[value];
+    graphics.generation = generation;
+    
+    if (!graphics.circle) {
+        graphics.circle = new QGraphicsEllipseItem(-NODE_RADIUS, -NODE_RADIUS,
+                                                   2 * NODE_RADIUS, 2 * NODE_RADIUS);
+        graphics.circle->setBrush(QBrush(defaultNodeColor));
+        graphics.circle->setPen(QPen(Qt::black));
+        graphics.circle->setPos(pos);
+        scene->addItem(graphics.circle);
+        
+        graphics.text = new QGraphicsTextItem(QString::number(value));
+        graphics.text->setDefaultTextColor(Qt::black);
+        graphics.text->setPos(pos.x() - 10, pos.y() - 10);
+        scene->addItem(graphics.text);
+    } else if (graphics.targetPos != pos) {
+        graphics.circle->setPos(pos);
+        graphics.text->setPos(pos.x() - 10, pos.y() - 10);
+    }
+    graphics.targetPos = pos;
+    
+    if (!parentPos) {
+        delete graphics.parentLine;
+        graphics.parentLine = nullptr;
+        return;
+    }
+    QLineF edge(*parentPos, pos);
+    if (!graphics.parentLine) {
+        // Edges stay below every circle, whatever order they were added in
+        graphics.parentLine = new QGraphicsLineItem(edge);
+        graphics.parentLine->setZValue(-1);
+        scene->addItem(graphics.parentLine);
+    } else if (graphics.parentLine->line() != edge) {
+        graphics.parentLine->setLine(edge);
+    }
+}
+
+void TreeVisualizer::removeNode(NodeGraphics& graphics) {
+    delete graphics.circle;
+    delete graphics.text;
+    delete graphics.parentLine;
+    graphics = NodeGraphics();
+}
+
+// Keys not drawn yet, such as one inserted while a layout is running, are
+// recorded anyway and coloured once that layout lands
 void TreeVisualizer::highlightPath(const std::vector<int>& path, QColor color) {
-    for (const auto& value : path) {
-        auto it = nodeItems.find(value);
-        if (it != nodeItems.end() && it->second.circle) {
-            it->second.circle->setBrush(QBrush(color));
-        }
+    for (int value : path) {
+        highlighted.emplace_back(value, color);
+        setNodeColor(value, color);
+    }
+    if (batchedItem) {
+        batchedItem->update();
     }
 }
 
+// Only the recoloured circles need resetting
 void TreeVisualizer::clearHighlights() {
-    for (auto& [value, graphics] : nodeItems) {
-        if (graphics.circle) {
-            graphics.circle->setBrush(QBrush(defaultNodeColor));
-        }
+    for (const auto& entry : highlighted) {
+        setNodeColor(entry.first, defaultNodeColor);
+    }
+    if (batchedItem) {
+        batchedItem->update();
+    }
+    highlighted.clear();
+}
+
+// A new drawing starts from default colours
+void TreeVisualizer::applyHighlights() {
+    for (const auto& [value, color] : highlighted) {
+        setNodeColor(value, color);
+    }
+    if (batchedItem) {
+        batchedItem->update();
+    }
+}
+
+void TreeVisualizer::setNodeColor(int value, QColor color) {
+    if (batchedItem) {
+        batchedItem->setColor(value, color);
+        return;
+    }
+    auto it = nodeItems.find(value);
+    if (it != nodeItems.end() && it->second.circle) {
+        it->second.circle->setBrush(QBrush(color));
     }
 }
 
 void TreeVisualizer::resizeEvent(QResizeEvent* event) {
     QGraphicsView::resizeEvent(event);
-    scene->setSceneRect(0, 0, event->size().width(), event->size().height());
-    if (!nodeItems.empty()) {
-        updateTree();
+    // Dragging a window edge sends a stream of these
+    resizeTimer->start();
+}
+
+void TreeVisualizer::fitToView() {
+    applyFit(1.0);
+}
+
+// What fitInView would do, with the same margin, except that small trees
+// keep their natural size and the user's zoom applies on top
+void TreeVisualizer::applyFit(double zoom) {
+    QRectF bounds = scene->sceneRect();
+    QRectF view = QRectF(viewport()->rect()).adjusted(2, 2, -2, -2);
+    if (bounds.isEmpty() || view.isEmpty()) {
+        return;
     }
+    QPointF centre = zoom == 1.0 ? bounds.center() : mapToScene(viewport()->rect().center());
+    fitScale = std::min({1.0, view.width() / bounds.width(), view.height() / bounds.height()});
+    setTransform(QTransform::fromScale(fitScale * zoom, fitScale * zoom));
+    centerOn(centre);
 }
@@ -8,8 +8,12 @@
 #include <QGraphicsLineItem>
 #include <QPropertyAnimation>
 #include <QParallelAnimationGroup>
+#include <QFutureWatcher>
+#include <QTimer>
 #include <map>
 #include "binarysearchtree.h"
+#include "batchedtreeitem.h"
+#include "treelayout.h"
 
 class TreeVisualizer : public QGraphicsView {
     Q_OBJECT
@@ -22,6 +26,7 @@ public:
     void highlightPath(const std::vector<int>& path, QColor color);
     void clearHighlights();
     void updateTree();
+    void fitToView();   // Scales the whole tree into the view, never above its natural size
 
 protected:
     void resizeEvent(QResizeEvent *event) override;
@@ -30,21 +35,42 @@ private:
     struct NodeGraphics {
         QGraphicsEllipseItem* circle = nullptr;
         QGraphicsTextItem* text = nullptr;
-        QGraphicsLineItem* parentLine = nullptr;
+        QGraphicsLineItem* parentLine = nullptr;  // Edge up to the parent, none for the root
         QPointF targetPos;
+        unsigned generation = 0;                  // Last layout that placed this node
     };
 
     QGraphicsScene* scene;
+    QFutureWatcher<std::vector<LayoutNode>>* layoutWatcher;
+    bool layoutPending = false;  // The tree changed while a layout was running
+    QTimer* resizeTimer;
+    double fitScale = 1.0;       // Scale of the last fit, before any zoom on top of it
     std::shared_ptr<BinarySearchTree> bst;
     std::map<int, NodeGraphics> nodeItems;
+    BatchedTreeItem* batchedItem = nullptr;  // Draws the whole tree instead of nodeItems when set
+    std::vector<std::pair<int, QColor>> highlighted;  // Keys highlightPath recoloured, repainted after each layout
+    unsigned generation = 0;
     const int NODE_RADIUS = 20;
     const int LEVEL_HEIGHT = 60;
+    const int NODE_SPACING = 2 * NODE_RADIUS + 10;  // One layout unit
+    
+    // Larger trees are painted by one BatchedTreeItem instead of items per node
+    static constexpr size_t BATCHED_RENDER_NODES = 2000;
+    static constexpr int RESIZE_SETTLE_MS = 100;
     QColor defaultNodeColor;
     QColor highlightColor;
 
-    void drawTree();
-    void calculateNodePositions(const std::shared_ptr<BSTNode>& node, double x, double y, 
-                              double width, std::map<int, NodeGraphics>& newItems);
+    void startLayout();
+    void applyLayout();
+    void applyFit(double zoom);
+    void drawTree(const std::vector<LayoutNode>& layout);
+    void drawItems(const std::vector<LayoutNode>& layout, const std::vector<QPointF>& positions);
+    void drawBatched(const std::vector<LayoutNode>& layout, std::vector<QPointF> positions);
+    void removeNodeItems();
+    void placeNode(int value, const QPointF& pos, const QPointF* parentPos);
+    void removeNode(NodeGraphics& graphics);
+    void setNodeColor(int value, QColor color);
+    void applyHighlights();
     void animateNodes(const std::map<int, NodeGraphics>& newItems);
     void clearScene();
 };